@@ -6,10 +6,37 @@ CC="${CXX:-cc}"
 PKGS="sdl2 glew freetype2"
 CFLAGS="-Wall -Wextra -std=c11 -pedantic -ggdb -I include"
 LIBS=-lm
-SRC="src/main.c src/la.c src/editor.c src/file_browser.c src/free_glyph.c src/simple_renderer.c src/common.c src/lexer.c"
+SRC="src/la.c src/editor.c src/file_browser.c src/free_glyph.c src/simple_renderer.c src/common.c src/lexer.c src/headless.c src/profiler.c src/replay.c src/finder.c src/buffers.c"
 
 if [ `uname` = "Darwin" ]; then
     CFLAGS+=" -framework OpenGL"
 fi
 
-$CC $CFLAGS `pkg-config --cflags $PKGS` -o detey $SRC $LIBS `pkg-config --libs $PKGS`
+# TRACE=1 ./build.sh compiles in the trace markers, dumped on F4 and at exit
+if [ -n "$TRACE" ]; then
+    CFLAGS="$CFLAGS -DDETEY_TRACE"
+    SRC="$SRC src/trace.c"
+fi
+
+# ALLOCS=1 ./build.sh counts the heap allocations of the frames and reports them at exit, glibc only
+if [ -n "$ALLOCS" ]; then
+    CFLAGS="$CFLAGS -DDETEY_COUNT_ALLOCS"
+    SRC="$SRC src/allocs.c"
+fi
+
+# EGL is only needed for the headless mode
+if [ `uname` = "Linux" ]; then
+    PKGS="$PKGS egl"
+fi
+
+# The software rasterizer runs per pixel on hosts without a GPU, unoptimized it is too slow
+# to be usable, so it is always compiled with -O2
+$CC $CFLAGS -O2 `pkg-config --cflags $PKGS` -c -o simple_software.o src/simple_software.c
+
+# ./build.sh bench builds the microbenchmarks of src/bench.c instead of the editor,
+# optimized since unoptimized numbers say nothing about a release
+if [ "$1" = "bench" ]; then
+    $CC $CFLAGS -O2 `pkg-config --cflags $PKGS` -o detey-bench src/bench.c $SRC simple_software.o $LIBS `pkg-config --libs $PKGS`
+else
+    $CC $CFLAGS `pkg-config --cflags $PKGS` -o detey src/main.c $SRC simple_software.o $LIBS `pkg-config --libs $PKGS`
+fi
@@ -0,0 +1,34 @@
+#ifndef ALLOCS_H_
+#define ALLOCS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Counts the heap allocations made by the main thread, those of SDL, FreeType and the drivers
+// included. Compiled out unless built with -DDETEY_COUNT_ALLOCS (`ALLOCS=1 ./build.sh`), which
+// replaces malloc() and friends of glibc with counting wrappers.
+//
+// Once the first second is over the frames without any input are expected to make no
+// allocations at all, whatever only lives for a frame goes into frame_alloc() instead.
+
+#ifdef DETEY_COUNT_ALLOCS
+
+size_t allocs_count(void);
+void allocs_frame_begin(void);
+void allocs_frame_end(bool input);
+// Prints how many of the frames allocated, if any were tallied
+void allocs_report(void);
+
+#define ALLOCS_FRAME_BEGIN() allocs_frame_begin()
+#define ALLOCS_FRAME_END(input) allocs_frame_end(input)
+#define ALLOCS_REPORT() allocs_report()
+
+#else
+
+#define ALLOCS_FRAME_BEGIN() ((void)0)
+#define ALLOCS_FRAME_END(input) ((void)(input))
+#define ALLOCS_REPORT() ((void)0)
+
+#endif // DETEY_COUNT_ALLOCS
+
+#endif // ALLOCS_H_
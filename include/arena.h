@@ -36,9 +36,31 @@
 #define ARENA_BACKEND_WASM_HEAPBASE 3
 
 #ifndef ARENA_BACKEND
+#ifdef __linux__
+#define ARENA_BACKEND ARENA_BACKEND_LINUX_MMAP
+#else
 #define ARENA_BACKEND ARENA_BACKEND_LIBC_MALLOC
+#endif // __linux__
 #endif // ARENA_BACKEND
 
+#if ARENA_BACKEND == ARENA_BACKEND_LINUX_MMAP
+// Every region reserves this much address space up front and commits it in ARENA_MMAP_COMMIT_SIZE
+// steps as it fills up, so an arena is one contiguous range that never moves. The reservation
+// costs nothing until it is committed and touched.
+#ifndef ARENA_MMAP_RESERVE_SIZE
+#define ARENA_MMAP_RESERVE_SIZE ((size_t)1 << 32)
+#endif // ARENA_MMAP_RESERVE_SIZE
+#ifndef ARENA_MMAP_COMMIT_SIZE
+#define ARENA_MMAP_COMMIT_SIZE ((size_t)64 * 1024)
+#endif // ARENA_MMAP_COMMIT_SIZE
+// arena_reset() hands the pages above this back to the OS
+#ifndef ARENA_MMAP_RETAIN_SIZE
+#define ARENA_MMAP_RETAIN_SIZE ((size_t)1024 * 1024)
+#endif // ARENA_MMAP_RETAIN_SIZE
+// The reservations are aligned to it, so the parts that grow past it get transparent huge pages
+#define ARENA_MMAP_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#endif // ARENA_BACKEND_LINUX_MMAP
+
 typedef struct Region Region;
 
 struct Region
@@ -46,6 +68,9 @@ struct Region
     Region *next;
     size_t count;
     size_t capacity;
+#if ARENA_BACKEND == ARENA_BACKEND_LINUX_MMAP
+    size_t committed; // bytes from the start of the region
+#endif // ARENA_BACKEND_LINUX_MMAP
     uintptr_t data[];
 };
 
@@ -94,8 +119,89 @@ void free_region(Region *r)
 {
     free(r);
 }
+
+static void region_commit(Region *r, size_t count)
+{
+    (void) r;
+    (void) count;
+}
+
+static void region_decommit(Region *r)
+{
+    (void) r;
+}
 #elif ARENA_BACKEND == ARENA_BACKEND_LINUX_MMAP
-#error "TODO: Linux mmap backend is not implemented yet"
+#include <sys/mman.h>
+
+// The region decides the capacity itself, it is at least the requested one
+Region *new_region(size_t capacity)
+{
+    size_t size_bytes = sizeof(Region) + sizeof(uintptr_t) * capacity;
+    if (size_bytes < ARENA_MMAP_RESERVE_SIZE)
+        size_bytes = ARENA_MMAP_RESERVE_SIZE;
+    size_bytes = (size_bytes + ARENA_MMAP_HUGE_PAGE_SIZE - 1) & ~(ARENA_MMAP_HUGE_PAGE_SIZE - 1);
+
+    // Reserve one huge page more than needed and unmap what sticks out of the aligned range
+    char *mem = mmap(NULL, size_bytes + ARENA_MMAP_HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ARENA_ASSERT(mem != MAP_FAILED);
+    char *begin = (char *)(((uintptr_t)mem + ARENA_MMAP_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(ARENA_MMAP_HUGE_PAGE_SIZE - 1));
+    char *end = begin + size_bytes;
+    if (begin > mem)
+        munmap(mem, (size_t)(begin - mem));
+    if (mem + size_bytes + ARENA_MMAP_HUGE_PAGE_SIZE > end)
+        munmap(end, (size_t)(mem + size_bytes + ARENA_MMAP_HUGE_PAGE_SIZE - end));
+#ifdef MADV_HUGEPAGE
+    // Only a hint, the kernel may have transparent huge pages disabled
+    madvise(begin, size_bytes, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+
+    int err = mprotect(begin, ARENA_MMAP_COMMIT_SIZE, PROT_READ | PROT_WRITE);
+    ARENA_ASSERT(err == 0);
+    Region *reg = (Region *)begin;
+    reg->next = NULL;
+    reg->count = 0;
+    reg->capacity = (size_bytes - sizeof(Region)) / sizeof(uintptr_t);
+    reg->committed = ARENA_MMAP_COMMIT_SIZE;
+    return reg;
+}
+
+void free_region(Region *r)
+{
+    munmap(r, sizeof(Region) + sizeof(uintptr_t) * r->capacity);
+}
+
+// Makes the first `count` words of the region writable
+static void region_commit(Region *r, size_t count)
+{
+    size_t needed = sizeof(Region) + sizeof(uintptr_t) * count;
+    if (needed <= r->committed)
+        return;
+
+    size_t total = sizeof(Region) + sizeof(uintptr_t) * r->capacity;
+    // Past the first huge page whole huge pages are committed at once, a page fault only gets
+    // a huge page when all of it is already mapped
+    size_t step = needed > ARENA_MMAP_HUGE_PAGE_SIZE ? ARENA_MMAP_HUGE_PAGE_SIZE : ARENA_MMAP_COMMIT_SIZE;
+    size_t committed = (needed + step - 1) & ~(step - 1);
+    if (committed > total)
+        committed = total;
+    int err = mprotect((char *)r + r->committed, committed - r->committed, PROT_READ | PROT_WRITE);
+    ARENA_ASSERT(err == 0);
+    r->committed = committed;
+}
+
+// Gives the pages past ARENA_MMAP_RETAIN_SIZE back, a region that grew once for a big job
+// does not keep holding on to its peak
+static void region_decommit(Region *r)
+{
+    if (r->committed <= ARENA_MMAP_RETAIN_SIZE)
+        return;
+
+    char *from = (char *)r + ARENA_MMAP_RETAIN_SIZE;
+    size_t size = r->committed - ARENA_MMAP_RETAIN_SIZE;
+    madvise(from, size, MADV_DONTNEED);
+    mprotect(from, size, PROT_NONE);
+    r->committed = ARENA_MMAP_RETAIN_SIZE;
+}
 #elif ARENA_BACKEND == ARENA_BACKEND_WIN32_VIRTUALALLOC
 #error "TODO: Win32 VirtualAlloc backend is not implemented yet"
 #elif ARENA_BACKEND == ARENA_BACKEND_WASM_HEAPBASE
@@ -139,6 +245,7 @@ void *arena_alloc(Arena *arena, size_t size_bytes)
         arena->end = arena->end->next;
     }
 
+    region_commit(arena->end, arena->end->count + size);
     void *result = &arena->end->data[arena->end->count];
     arena->end->count += size;
     return result;
@@ -163,6 +270,7 @@ void arena_reset(Arena *arena)
     for (Region *r = arena->begin; r != NULL; r = r->next)
     {
         r->count = 0;
+        region_decommit(r);
     }
 
     arena->end = arena->begin;
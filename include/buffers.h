@@ -0,0 +1,62 @@
+#ifndef BUFFERS_H_
+#define BUFFERS_H_
+
+#include <stdbool.h>
+#include "common.h"
+#include "editor.h"
+#include "free_glyph.h"
+#include "simple_renderer.h"
+
+// The open files. Every buffer is an Editor of its own with its own cursor, tokens and camera,
+// while the glyph atlas and the renderer are shared by all of them. Switching is only a matter
+// of pointing at another buffer, as long as the inactive buffers keep their lines, tokens and
+// layouts. Those are what takes up most of the memory of a buffer, so past a budget the least
+// recently used buffers drop them and lex their text again once they are switched back to.
+//
+// A buffer can be split into views, which share everything of it but the cursor and the
+// camera. editor_render() only draws the rows a view shows, so a second view of a big file
+// costs only what is on its screen.
+
+#define BUFFERS_DEFAULT_BUDGET_MB 64
+
+// There is always a buffer, the first one is empty and has no file
+void buffers_init(Free_Glyph_Atlas *atlas);
+// How much the derived data of the inactive buffers may take up, in bytes
+void buffers_set_budget(size_t budget);
+
+Editor *buffers_current(void);
+size_t buffers_count(void);
+// Switches to the buffer of the file, loading it into a new one if it is not open yet. The
+// empty buffer the editor starts with is replaced by the first file.
+Errno buffers_open(const char *file_path, Simple_Renderer *sr);
+// Goes delta buffers forward or backward, wrapping around
+void buffers_switch(int delta, Simple_Renderer *sr);
+// Closes the current buffer unless it has unsaved changes, false if it did not
+bool buffers_close(Simple_Renderer *sr);
+
+// Picks up the changes made to the open files by other programs. The buffers that dropped
+// their derived data catch up once they are switched back to.
+void buffers_poll_changes(void);
+// Draws the views of the current buffer, then in screen space the dividers between them and
+// the tabs when more than one buffer is open
+void buffers_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas);
+
+// Splits the focused view of the current buffer in two, side by side or one above the other.
+// The new half starts out at the same cursor and camera and takes the focus.
+void buffers_split(bool side_by_side);
+// Gives the space of the focused view to its neighbours, the last view of a buffer stays
+void buffers_close_view(void);
+void buffers_focus_next_view(void);
+// Moves the cursors of the other views of the current buffer along with an edit made at the
+// focused cursor. count and cursor are the size of the text and the cursor from before it.
+void buffers_track_edit(size_t count, size_t cursor);
+
+// The open files with their views, cursors and cameras, kept in the cache directory from one
+// run of the editor in a directory to the next. The lines and the tokens of the files that did
+// not change in the meantime are kept too, so even a big file is back without being lexed again.
+Errno buffers_save_session(void);
+// Has to come right after buffers_init(), with the atlas already set up. ENOENT if there is no
+// session yet.
+Errno buffers_restore_session(Simple_Renderer *sr);
+
+#endif // BUFFERS_H_
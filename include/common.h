@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "./la.h"
+#include "arena.h"
 
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
@@ -68,24 +69,29 @@ typedef int Errno;
         (da)->items[(da)->count++] = (item);                                           \
     } while (0)
 
-#define da_append_many(da, new_items, new_items_count)                                        \
-    do {                                                                                      \
-        if ((da)->count + new_items_count > (da)->capacity) {                                 \
-            if ((da)->capacity == 0) {                                                        \
-                (da)->capacity = DA_INIT_CAP;                                                 \
-            }                                                                                 \
-            while ((da)->count + new_items_count > (da)->capacity) {                          \
-                (da)->capacity *= 2;                                                          \
-            }                                                                                 \
-            (da)->items = realloc((da)->items, (da)->capacity * sizeof(*(da)->items));        \
-            assert((da)->items != NULL && "Buy more RAM lol");                                \
-        }                                                                                     \
-        memcpy((da)->items + (da)->count, new_items, new_items_count * sizeof(*(da)->items)); \
-        (da)->count += new_items_count;                                                       \
+#define da_append_many(da, new_items, new_items_count)                                  \
+    do {                                                                                \
+        size_t da_n = (new_items_count);                                                \
+        if ((da)->count + da_n > (da)->capacity) {                                      \
+            if ((da)->capacity == 0) {                                                  \
+                (da)->capacity = DA_INIT_CAP;                                           \
+            }                                                                           \
+            while ((da)->count + da_n > (da)->capacity) {                               \
+                (da)->capacity *= 2;                                                    \
+            }                                                                           \
+            (da)->items = realloc((da)->items, (da)->capacity * sizeof(*(da)->items));  \
+            assert((da)->items != NULL && "Buy more RAM lol");                          \
+        }                                                                               \
+        memcpy((da)->items + (da)->count, (new_items), da_n * sizeof(*(da)->items));    \
+        (da)->count += da_n;                                                            \
     } while (0)
 
-char *temp_strdup(const char *s);
-void temp_reset(void);
+// Scratch memory for whatever does not outlive the frame it is made in. The main loop resets
+// it at the top of every frame, so the frames do not have to go through malloc() and free() for
+// their temporary paths and strings. Only for the main thread.
+void *frame_alloc(size_t size);
+char *frame_sprintf(const char *fmt, ...);
+void frame_reset(void);
 
 typedef struct {
     char *items;
@@ -107,22 +113,58 @@ typedef struct {
 
 #define sb_to_sv(sb) sv_from_parts((sb).items, (sb).count)
 
-typedef struct {
-    const char **items;
-    size_t count;
-    size_t capacity;
-} Files;
-
 typedef enum {
     FT_REGULAR,
     FT_DIRECTORY,
     FT_OTHER,
 } File_Type;
 
+// A name with its length in front of it, allocated in the arena of the listing it belongs to.
+// It is NUL terminated too, for the C APIs.
+typedef struct {
+    uint32_t len;
+    char data[];
+} File_Name;
+
+// A directory entry along with everything the file browser shows of it, captured once when
+// the directory is read instead of on every frame
+typedef struct {
+    const File_Name *name;
+    File_Type type;
+} File_Entry;
+
+typedef struct {
+    File_Entry *items;
+    size_t count;
+    size_t capacity;
+} Files;
+
+// What the file looked like the last time it was seen, to tell if it changed since without
+// reading it
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} File_Stamp;
+
 Errno type_of_file(const char *file_path, File_Type *ft);
+Errno stamp_of_file(const char *file_path, File_Stamp *stamp);
 Errno read_entire_file(const char *file_path, String_Builder *sb);
 Errno write_entire_file(const char *file_path, const char *buf, size_t buf_size);
-Errno read_entire_dir(const char *dir_path, Files *files);
+// Appends the entries of the directory to files, with their names allocated in the names arena
+Errno read_entire_dir(const char *dir_path, Files *files, Arena *names);
+const File_Name *file_name_new(Arena *arena, const char *name, size_t len);
+
+// Maps the whole file read-only into memory. Release it with unmap_entire_file().
+Errno map_entire_file(const char *file_path, const char **data, size_t *size);
+void unmap_entire_file(const char *data, size_t size);
+
+// Builds the path of `file_name` inside of the per-user cache directory
+// ($XDG_CACHE_HOME/detey or ~/.cache/detey), creating the directory if needed.
+Errno cache_file_path(const char *file_name, String_Builder *path);
+
+// FNV-1a
+uint64_t hash_bytes(const char *data, size_t size);
 
 Vec4f hex_to_vec4f(uint32_t color);
 
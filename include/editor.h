@@ -9,10 +9,13 @@
 
 #include <SDL2/SDL.h>
 
+#define LINE_NO_LAYOUT SIZE_MAX
+
 typedef struct
 {
     size_t begin;
     size_t end;
+    size_t layout; // where the x advances of the line start in Editor.layout, LINE_NO_LAYOUT until asked for
 } Line;
 
 typedef struct
@@ -29,6 +32,25 @@ typedef struct
     size_t capacity;
 } Tokens;
 
+typedef struct
+{
+    float *items;
+    size_t count;
+    size_t capacity;
+} Layout;
+
+// Reads the file on a thread after another process changed it, so even a big one does not
+// stall a frame
+typedef struct
+{
+    SDL_Thread *thread;
+    SDL_atomic_t done;
+    bool again; // it changed once more while it was being read
+    String_Builder file_path;
+    String_Builder contents;
+    Errno err;
+} Editor_Reload;
+
 typedef struct
 {
     Free_Glyph_Atlas *atlas;
@@ -36,6 +58,9 @@ typedef struct
     String_Builder data;
     Lines lines;
     Tokens tokens;
+    // For every line that was asked for since the last edit the x of each of its columns,
+    // line.end - line.begin + 1 of them, so positioning the cursor does not walk the line
+    Layout layout;
     String_Builder file_path;
 
     bool searching;
@@ -48,11 +73,35 @@ typedef struct
     Uint32 last_stroke;
 
     String_Builder clipboard;
+
+    // Watch of the directory of file_path for the file being rewritten by other processes, Linux only
+    bool watching;
+    int watch_fd;
+    int watch;
+    size_t watch_name; // where the name of the file starts in file_path
+    uint64_t file_hash; // of the contents as last loaded or saved, the buffer is clean while it matches
+    Editor_Reload reload;
 } Editor;
 
 Errno editor_save_as(Editor *editor, const char *file_path);
-Errno editor_save(const Editor *editor);
+Errno editor_save(Editor *editor);
 Errno editor_load_from_file(Editor *editor, const char *file_path);
+// editor_load_from_file() without the lexing and the hashing, for when the lines, the tokens and
+// the hash of the contents are known from before. The caller fills them in, or calls
+// editor_retokenize() and hashes the contents itself.
+Errno editor_load_text_from_file(Editor *editor, const char *file_path);
+// Reloads the file once another process is done writing it, without blocking. A clean buffer
+// gets only the lines that differ patched in, keeping the cursor where it was. A dirty one is
+// left alone with a warning.
+void editor_poll_changes(Editor *editor);
+// Stops watching the file and frees everything, the editor is empty afterwards
+void editor_free(Editor *editor);
+// Bytes taken up by what editor_retokenize() makes out of the text: the lines, the tokens and
+// the layout of the lines
+size_t editor_derived_size(const Editor *editor);
+// Frees all of that, editor_retokenize() brings it back. Nothing else may be done with the
+// editor in between.
+void editor_drop_derived(Editor *editor);
 
 void editor_backspace(Editor *editor);
 void editor_delete(Editor *editor);
@@ -78,7 +127,11 @@ void editor_move_paragraph_down(Editor *e);
 void editor_insert_char(Editor *e, char x);
 void editor_insert_buf(Editor *e, char *buf, size_t buf_len);
 void editor_retokenize(Editor *e);
-void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr, Editor *editor);
+// Replaces the contents with new ones, diffing them by lines and lexing only the lines that
+// changed. The cursor and the selection move along with the text around them. The old contents
+// end up in `contents`.
+void editor_patch(Editor *e, String_Builder *contents);
+void editor_render(Free_Glyph_Atlas *atlas, Simple_Renderer *sr, Editor *editor);
 void editor_update_selection(Editor *e, bool shift);
 void editor_clipboard_copy(Editor *e);
 void editor_clipboard_paste(Editor *e);
@@ -86,5 +139,9 @@ void editor_start_search(Editor *e);
 void editor_stop_search(Editor *e);
 void editor_formatting_indent(Editor *e);
 bool editor_search_matches_at(Editor *e, size_t pos);
+// x of the column of the row, relative to the beginning of the line
+float editor_line_x(Editor *e, size_t row, size_t col);
+// The column of the row closest to x
+size_t editor_line_col(Editor *e, size_t row, float x);
 
 #endif // EDITOR_H_
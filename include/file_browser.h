@@ -3,20 +3,53 @@
 
 #include "./common.h"
 #include "free_glyph.h"
+#include "sv.h"
 
 #include <SDL2/SDL.h>
 
+// A create, delete or rename in the directory on display
+typedef struct
+{
+    File_Entry entry;
+    bool exists;
+    size_t order; // of arrival, only the last change of a name counts
+} File_Change;
+
+typedef struct
+{
+    File_Change *items;
+    size_t count;
+    size_t capacity;
+} File_Changes;
+
 typedef struct
 {
     Files files;
+    Arena names; // of the files, reset whenever the directory is read again
+    Arena spare_names; // the live names are moved over here once most of names is dead
+    size_t names_size; // bytes taken from names
+    size_t names_live; // of them still in the listing
+    size_t longest; // the entry with the longest name
     size_t cursor;
     String_Builder dir_path;
     String_Builder file_path;
+
+    // inotify watch of dir_path, Linux only
+    bool watching;
+    int watch_fd;
+    int watch;
+    File_Changes changes;
+    Files merged;
 } File_Browser;
 
 Errno fb_open_dir(File_Browser *fb, const char *dir_path);
 Errno fb_change_dir(File_Browser *fb);
-void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
+void fb_render(const File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
 const char *fb_file_path(File_Browser *fb);
+// Merges the files created, deleted and renamed in the directory since the last call into the
+// listing without reading the directory again. The cursor stays on the same entry.
+void fb_poll_changes(File_Browser *fb);
+// Collapses `.`, `..` and repeated separators of path like Python's os.path.normpath() and appends it to result
+void normpath(String_View path, String_Builder *result);
 
 #endif // FILE_BROWSER_H_
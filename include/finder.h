@@ -0,0 +1,32 @@
+#ifndef FINDER_H_
+#define FINDER_H_
+
+#include <stdbool.h>
+#include "simple_renderer.h"
+#include "free_glyph.h"
+
+// Fuzzy "open file" palette (Ctrl+P). A background thread crawls the tree under the current
+// directory into a path index, honoring the .gitignore files and skipping the usual vendored
+// directories. The palette ranks whatever is indexed so far in frame sized steps spread over
+// all the cores, so the results show up right away and keep improving as the index fills.
+
+// Starts the crawler, only the first call does anything
+void finder_start_indexing(void);
+
+void finder_open(void);
+void finder_close(void);
+bool finder_opened(void);
+
+void finder_insert_text(const char *text);
+void finder_backspace(void);
+void finder_move_cursor(int delta);
+// The selected result relative to the current directory, NULL when there are no results
+const char *finder_selected_path(void);
+
+// Ranks the newly indexed paths and the candidates of a changed query within a time budget.
+// Call it once per frame, it does nothing while the palette is closed.
+void finder_update(void);
+// Draws the palette in screen space on top of whatever was rendered this frame
+void finder_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas);
+
+#endif // FINDER_H_
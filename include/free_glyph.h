@@ -35,17 +35,20 @@ typedef struct
 
 #define GLYPH_METRICS_CAPACITY 128
 
+static_assert(GLYPH_METRICS_CAPACITY <= SIMPLE_GLYPH_METRICS_CAP, "Glyph metrics do not fit into the renderer glyph table");
+
 typedef struct
 {
     FT_UInt atlas_width;
     FT_UInt atlas_height;
-    GLuint glyphs_texture;
+    uint8_t *pixels; // atlas_width * atlas_height single channel SDF bitmap
     Glyph_Metric metrics[GLYPH_METRICS_CAPACITY];
 } Free_Glyph_Atlas;
 
-void free_glyph_atlas_init(Free_Glyph_Atlas *atlas, FT_Face face);
-float free_glyph_atlas_cursor_pos(const Free_Glyph_Atlas *atlas, const char *text, size_t text_size, Vec2f pos, size_t col);
+void free_glyph_atlas_init(Free_Glyph_Atlas *atlas, FT_Face face, const char *font_file_path);
 void free_glyph_atlas_measure_line_sized(Free_Glyph_Atlas *atlas, const char *text, size_t text_size, Vec2f *pos);
 void free_glyph_atlas_render_line_sized(Free_Glyph_Atlas *atlas, Simple_Renderer *sr, const char *text, size_t text_size, Vec2f *pos, Vec4f color);
+// Hands the bitmap and the glyph metrics over to the renderer for the instanced text path
+void free_glyph_atlas_bind(const Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
 
 #endif // FREE_GLYPH_H_
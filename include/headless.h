@@ -0,0 +1,32 @@
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+#include <stdbool.h>
+#include "file_browser.h"
+#include "free_glyph.h"
+#include "simple_renderer.h"
+
+// Renders without a window into an offscreen framebuffer, so the renderer can be
+// benchmarked on machines without a display or a GPU (Mesa llvmpipe or the software
+// backend of the renderer are good enough).
+#define HEADLESS_DEFAULT_FRAMES 600
+
+typedef struct
+{
+    size_t frames;
+    int width;
+    int height;
+    bool file_browser; // drive fb_render() instead of editor_render()
+    const char *dump_path; // where to save the last frame, if anywhere
+} Headless_Config;
+
+// Creates a GL 3.3 core context in place of the SDL window. Not needed by the software backend.
+// Only available on Linux via EGL surfaceless contexts.
+bool headless_init(void);
+// Renders the current buffer into an offscreen framebuffer for as many frames as the loaded replay
+// recorded, driven by its input, or else for config->frames frames of scripted scrolling and typing,
+// printing a line of timings and counters per frame and a summary at the end.
+// Returns the process exit code.
+int headless_run(const Headless_Config *config, File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
+
+#endif // HEADLESS_H_
@@ -0,0 +1,46 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdbool.h>
+#include "simple_renderer.h"
+#include "free_glyph.h"
+
+// Frame profiler with an on screen overlay (F3). Costs a flag check per stage while it is off.
+
+typedef enum
+{
+    PROFILER_STAGE_EVENTS = 0,
+    PROFILER_STAGE_RETOKENIZE,
+    PROFILER_STAGE_GENERATE,   // building the verticies and quads of the frame
+    PROFILER_STAGE_SYNC,       // simple_renderer_sync()
+    PROFILER_STAGE_DRAW,       // simple_renderer_draw() on the CPU, the whole rasterization for the software backend
+    PROFILER_STAGE_SWAP,
+    COUNT_PROFILER_STAGES,
+} Profiler_Stage;
+
+#define PROFILER_HISTORY_CAP 240
+
+typedef struct
+{
+    float stage_ms[COUNT_PROFILER_STAGES];
+    float gpu_ms; // from GL timer queries a few frames later, negative until then or when the GPU fell too far behind
+    Simple_Renderer_Stats stats;
+} Profiler_Frame;
+
+// Takes effect at the next profiler_frame_begin(), so the stages of a frame are never cut in half
+void profiler_toggle(void);
+bool profiler_enabled(void);
+
+void profiler_frame_begin(Simple_Renderer *sr);
+void profiler_frame_end(Simple_Renderer *sr);
+
+// Stages nest and only measure their own time, everything spent in a nested stage is
+// accounted to that stage instead (e.g. SYNC inside of GENERATE).
+void profiler_begin(Profiler_Stage stage);
+void profiler_end(Profiler_Stage stage);
+
+// Draws the overlay in screen space on top of whatever was rendered this frame.
+// The draws of the overlay itself do not show up in the stats.
+void profiler_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas);
+
+#endif // PROFILER_H_
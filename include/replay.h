@@ -0,0 +1,38 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "common.h"
+
+// Records the keyboard input of a session (--record) and plays it back (--replay) through
+// the same event handling, either in the window or in the headless mode. Every event is
+// replayed in the same frame it arrived in during the recording, so a replay against the
+// same file ends up in the same state no matter how fast the machine is. Live sessions
+// measure the keystroke to present latency of the user's input too.
+//
+// The recording is the raw Replay_Event structs after a header, it is only meant to be
+// replayed by a build for the same platform.
+
+// Starts recording into file_path. data is the buffer the session starts with, a replay
+// warns when it is started against a different one.
+Errno replay_record_begin(const char *file_path, const char *data, size_t size);
+// Keeps the key presses and the text input, ignores everything else
+void replay_record_event(const SDL_Event *event, size_t frame);
+Errno replay_record_end(void);
+
+Errno replay_load(const char *file_path, const char *data, size_t size);
+bool replay_playing(void);
+// The frame the last recorded event arrived in
+size_t replay_last_frame(void);
+// Pops the next event recorded at the given frame, false once there are no more for it
+bool replay_poll_event(size_t frame, SDL_Event *event);
+// Measures the latency of an event of the user from when SDL received it
+void replay_track_event(const SDL_Event *event);
+// Call once the frame with the polled or tracked events is on the screen. The time from
+// polling an event to this is its keystroke to present latency.
+void replay_frame_presented(void);
+// Prints the latency percentiles of all the replayed or tracked events, if there were any
+void replay_report(void);
+
+#endif // REPLAY_H_
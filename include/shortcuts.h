@@ -11,6 +11,10 @@
 #include "simple_renderer.h"
 #include "free_glyph.h"
 #include "common.h"
+#include "profiler.h"
+#include "trace.h"
+#include "finder.h"
+#include "buffers.h"
 
 static inline void shortcuts_handle_keydown(SDL_Event *event,
                                             bool *file_browser,
@@ -23,6 +27,68 @@ static inline void shortcuts_handle_keydown(SDL_Event *event,
     SDL_Keycode sym = event->key.keysym.sym;
     Uint16 mod = event->key.keysym.mod;
 
+    if (sym == SDLK_F3)
+    {
+        profiler_toggle();
+        return;
+    }
+
+    if (sym == SDLK_F4)
+    {
+        TRACE_DUMP();
+        return;
+    }
+
+    if (sym == SDLK_p && (mod & KMOD_CTRL))
+    {
+        if (finder_opened()) finder_close();
+        else finder_open();
+        return;
+    }
+
+    if (finder_opened())
+    {
+        switch (sym)
+        {
+            case SDLK_ESCAPE:
+                finder_close();
+                return;
+            case SDLK_BACKSPACE:
+                finder_backspace();
+                return;
+            case SDLK_UP:
+                finder_move_cursor(-1);
+                return;
+            case SDLK_DOWN:
+                finder_move_cursor(1);
+                return;
+            case SDLK_RETURN:
+            {
+                const char *file_path = finder_selected_path();
+                if (!file_path) return;
+                *err = buffers_open(file_path, sr);
+                if (*err != 0) {
+                    fprintf(stderr, "Could not open file %s: %s\n", file_path, strerror(*err));
+                } else {
+                    finder_close();
+                    *file_browser = false;
+                }
+                return;
+            }
+            default:
+                return;
+        }
+    }
+
+    // Ctrl+Tab and Ctrl+PageDown go to the next buffer, with Shift or PageUp to the previous one
+    if ((sym == SDLK_TAB || sym == SDLK_PAGEDOWN || sym == SDLK_PAGEUP) && (mod & KMOD_CTRL))
+    {
+        bool back = sym == SDLK_PAGEUP || (sym == SDLK_TAB && (mod & KMOD_SHIFT));
+        buffers_switch(back ? -1 : 1, sr);
+        *file_browser = false;
+        return;
+    }
+
     if (*file_browser)
     {
         switch (sym)
@@ -56,7 +122,7 @@ static inline void shortcuts_handle_keydown(SDL_Event *event,
                         }
                         break;
                     case FT_REGULAR:
-                        *err = editor_load_from_file(editor, file_path);
+                        *err = buffers_open(file_path, sr);
                         if (*err != 0) {
                             fprintf(stderr, "Could not open file %s: %s\n", file_path, strerror(*err));
                         } else {
@@ -76,6 +142,10 @@ static inline void shortcuts_handle_keydown(SDL_Event *event,
     }
 
     /* editor mode */
+    // For the other views of the buffer to follow the edits
+    const size_t count = editor->data.count;
+    const size_t cursor = editor->cursor;
+
     switch (sym)
     {
         case SDLK_HOME:
@@ -121,6 +191,26 @@ static inline void shortcuts_handle_keydown(SDL_Event *event,
             }
             break;
 
+        case SDLK_w:
+            if ((mod & KMOD_CTRL) && (mod & KMOD_SHIFT)) {
+                buffers_close_view();
+            } else if (mod & KMOD_CTRL) {
+                // The editor is gone if it was closed
+                buffers_close(sr);
+                return;
+            }
+            break;
+
+        case SDLK_BACKSLASH:
+            if (mod & KMOD_CTRL) {
+                buffers_split(!(mod & KMOD_SHIFT));
+            }
+            break;
+
+        case SDLK_F6:
+            buffers_focus_next_view();
+            break;
+
         case SDLK_z:
             if (mod & KMOD_CTRL) {
                 // TODO: implement undo
@@ -233,6 +323,31 @@ static inline void shortcuts_handle_keydown(SDL_Event *event,
 
         default: break;
     }
+
+    buffers_track_edit(count, cursor);
+}
+
+static inline void shortcuts_handle_textinput(SDL_Event *event,
+                                              bool *file_browser,
+                                              Editor *editor)
+{
+    if (finder_opened()) {
+        finder_insert_text(event->text.text);
+    }
+    else if (*file_browser) {
+        // Nothing for now
+    }
+    else {
+        const size_t count = editor->data.count;
+        const size_t cursor = editor->cursor;
+        const char *text = event->text.text;
+        size_t text_len = strlen(text);
+        for (size_t i = 0; i < text_len; ++i) {
+            editor_insert_char(editor, text[i]);
+        }
+        editor->last_stroke = SDL_GetTicks();
+        buffers_track_edit(count, cursor);
+    }
 }
 
 #endif // SHORTCUTS_H
\ No newline at end of file
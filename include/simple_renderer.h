@@ -2,6 +2,9 @@
 #define SIMPLE_RENDERER_H_
 
 #include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -27,16 +30,68 @@ typedef enum
     SIMPLE_VERTEX_ATTR_UV,
 } Simple_Vertex_Attr;
 
+// Packed down to 16 bytes: the color is RGBA8 and the uv is 16 bit, both normalized
+// by the vertex attribute setup, so the shaders still see them as floats in [0, 1].
 typedef struct
 {
     Vec2f position;
-    Vec4f color;
-    Vec2f uv;
+    uint8_t color[4];
+    uint16_t uv[2];
 } Simple_Vertex;
 
-#define SIMPLE_VERTICIES_CAP (3 * 640 * 1000)
+static_assert(sizeof(Simple_Vertex) == 16, "Simple_Vertex is expected to be tightly packed");
+
+typedef enum
+{
+    SIMPLE_QUAD_ATTR_POSITION = 0,
+    SIMPLE_QUAD_ATTR_SIZE,
+    SIMPLE_QUAD_ATTR_COLOR,
+    SIMPLE_QUAD_ATTR_INDEX,
+    SIMPLE_QUAD_ATTR_SHADER,
+} Simple_Quad_Attr;
+
+#define SIMPLE_QUAD_NO_GLYPH UINT16_MAX
+
+// One instance per rectangle or character. The vertex shader expands it into a quad,
+// taking the size of the glyphs from the metrics table (see simple_renderer_set_glyph_metrics()),
+// and the uber fragment shader picks the shading by the `shader` of the instance. This way
+// all the rectangles and text of a frame go out in a single ordered instanced draw call.
+typedef struct
+{
+    Vec2f position; // pen position of a glyph or the corner of a rectangle
+    Vec2f size;     // only used by rectangles
+    uint8_t color[4];
+    uint16_t index; // glyph index or SIMPLE_QUAD_NO_GLYPH for rectangles
+    uint8_t shader; // Simple_Shader
+    uint8_t padding;
+} Simple_Quad;
+
+static_assert(sizeof(Simple_Quad) == 24, "Simple_Quad is expected to be tightly packed");
+
+// Must match the size of the arrays in the Glyph_Metrics block of shaders/simple_quad.vert
+#define SIMPLE_GLYPH_METRICS_CAP 128
+
+typedef struct
+{
+    size_t draw_calls;
+    size_t gl_calls; // every GL call the renderer issues, draws included
+    size_t verticies;
+    size_t quads;
+    size_t bytes_uploaded;
+} Simple_Renderer_Stats;
+
+// Verticies are batched on the CPU and flushed automatically once the batch is full,
+// so the capacity only limits how much is uploaded at once, not how much a frame can draw.
+#define SIMPLE_VERTICIES_CAP (3 * 1024 * 16)
+// The GL vertex buffer is a ring of several batches that gets orphaned when it wraps around.
+#define SIMPLE_VERTICIES_RING_CAP (4 * SIMPLE_VERTICIES_CAP)
+
+#define SIMPLE_QUADS_CAP (1024 * 16)
+#define SIMPLE_QUADS_RING_CAP (4 * SIMPLE_QUADS_CAP)
 
 static_assert(SIMPLE_VERTICIES_CAP % 3 == 0, "Simple renderer vertex capacity must be divisible by 3. We are rendring triangles after all.");
+static_assert(SIMPLE_VERTICIES_RING_CAP % SIMPLE_VERTICIES_CAP == 0, "Vertex ring must fit a whole number of batches");
+static_assert(SIMPLE_QUADS_RING_CAP % SIMPLE_QUADS_CAP == 0, "Quad ring must fit a whole number of batches");
 
 typedef enum
 {
@@ -47,27 +102,98 @@ typedef enum
     COUNT_SIMPLE_SHADERS,
 } Simple_Shader;
 
+typedef enum
+{
+    SIMPLE_BACKEND_GL = 0,
+    // Rasterizes on the CPU for hosts without a GPU, see simple_software.h
+    SIMPLE_BACKEND_SOFTWARE,
+} Simple_Backend;
+
+struct Simple_Software;
+
 typedef struct
 {
+    GLuint id;
+    // Resolved once after linking
+    GLint uniforms[COUNT_UNIFORM_SLOTS];
+    // Values last uploaded into the program, so the unchanged ones are not uploaded again
+    bool synced;
+    Vec2f resolution;
+    float time;
+    Vec2f camera_pos;
+    float camera_scale;
+} Simple_Program;
+
+typedef struct
+{
+    Simple_Backend backend; // must be chosen before simple_renderer_init()
+    struct Simple_Software *software;
+
     GLuint vao;
     GLuint vbo;
-    GLuint programs[COUNT_SIMPLE_SHADERS];
+    Simple_Program programs[COUNT_SIMPLE_SHADERS];
     Simple_Shader current_shader;
 
-    GLint uniforms[COUNT_UNIFORM_SLOTS];
+    // shaders/simple_quad.vert linked against shaders/simple_uber.frag for the instanced path
+    GLuint quad_vao;
+    GLuint quad_vbo;
+    GLuint glyph_metrics_ubo;
+    GLuint glyph_atlas_texture;
+    Simple_Program quad_program;
+
+    // CPU side copy of the glyph metrics for the software backend
+    Vec4f glyph_rects[SIMPLE_GLYPH_METRICS_CAP];
+    Vec4f glyph_uvs[SIMPLE_GLYPH_METRICS_CAP];
+
+    // GL state as last set by the renderer, so redundant binds can be skipped.
+    // Nothing outside of the renderer is expected to touch these bindings.
+    GLuint bound_program;
+    GLuint bound_vao;
+    GLuint bound_array_buffer;
+    size_t quad_attribs_base; // ring offset the quad attribute pointers currently point at
+
     Simple_Vertex verticies[SIMPLE_VERTICIES_CAP];
     size_t verticies_count;
+    size_t ring_offset;  // where the next batch goes in the GL vertex buffer
+    size_t ring_drawn;   // where the last synced batch went in the GL vertex buffer
 
-    Vec2f resolution;
+    Simple_Quad quads[SIMPLE_QUADS_CAP];
+    size_t quads_count;
+    size_t quads_ring_offset;
+    size_t quads_ring_drawn;
+
+    Simple_Renderer_Stats stats; // accumulated until reset by the caller
+
+    Vec2f resolution; // of the viewport, the whole framebuffer unless one was set
+    Vec2f framebuffer; // as big as the last simple_renderer_resize()
+    Vec2f viewport_pos; // top left corner of the viewport in the framebuffer
     float time;
+    float delta_time; // how far the camera animates per frame, DELTA_TIME unless the caller measures frames
 
     Vec2f camera_pos;
     float camera_scale;
     float camera_scale_vel;
     Vec2f camera_vel;
+
+    // What simple_renderer_end_overlay() puts back
+    bool overlay;
+    Vec2f overlay_camera_pos;
+    float overlay_camera_scale;
+    Simple_Shader overlay_shader;
 } Simple_Renderer;
 
 void simple_renderer_init(Simple_Renderer *sr);
+// Sets the resolution along with the size of whatever the backend renders into
+void simple_renderer_resize(Simple_Renderer *sr, int width, int height);
+// Confines the drawing to a rectangle of the framebuffer, in pixels from the top left corner.
+// The resolution becomes the size of the rectangle and the camera centers on the middle of it,
+// so whatever lays itself out by the resolution fits into it. Flushes what was drawn before.
+void simple_renderer_set_viewport(Simple_Renderer *sr, Vec2f pos, Vec2f size);
+// Back to the whole framebuffer
+void simple_renderer_reset_viewport(Simple_Renderer *sr);
+void simple_renderer_clear(Simple_Renderer *sr, Vec4f color);
+// Copies the last rendered frame as RGBA8, top row first
+void simple_renderer_read_pixels(Simple_Renderer *sr, uint8_t *pixels);
 
 void simple_renderer_reload_shaders(Simple_Renderer *sr);
 
@@ -82,8 +208,23 @@ void simple_renderer_quad(Simple_Renderer *sr,
                           Vec2f p0, Vec2f p1, Vec2f p2, Vec2f p3,
                           Vec4f c0, Vec4f c1, Vec4f c2, Vec4f c3,
                           Vec2f uv0, Vec2f uv1, Vec2f uv2, Vec2f uv3);
+// Rectangles and glyphs are shaded with the shader that is current at the time they are added
 void simple_renderer_solid_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec4f c);
 void simple_renderer_image_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec2f uvp, Vec2f uvs, Vec4f c);
+// Single channel bitmap that the image and text shaders sample from
+void simple_renderer_set_glyph_atlas(Simple_Renderer *sr, const uint8_t *pixels, size_t width, size_t height);
+// rects are (left bearing, top bearing, width, height), uvs are (u, v, width, height)
+void simple_renderer_set_glyph_metrics(Simple_Renderer *sr, const Vec4f *rects, const Vec4f *uvs, size_t count);
+void simple_renderer_glyph(Simple_Renderer *sr, Vec2f pen, size_t index, Vec4f c);
+// Everything drawn until simple_renderer_end_overlay() is laid out in pixels of the viewport with
+// the origin in its top left corner, on top of what was drawn before, with the text being the
+// atlas scaled down by scale. The end puts the camera and the shader of the caller back.
+void simple_renderer_begin_overlay(Simple_Renderer *sr, float scale);
+void simple_renderer_end_overlay(Simple_Renderer *sr);
+// Pixels of the overlay into its camera space, for the pens of the text
+Vec2f simple_renderer_overlay_point(const Simple_Renderer *sr, float x, float y);
+// Rectangle in pixels of the overlay, (x, y) being its top left corner
+void simple_renderer_overlay_rect(Simple_Renderer *sr, float x, float y, float w, float h, Vec4f c);
 void simple_renderer_flush(Simple_Renderer *sr);
 void simple_renderer_sync(Simple_Renderer *sr);
 void simple_renderer_draw(Simple_Renderer *sr);
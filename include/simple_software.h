@@ -0,0 +1,24 @@
+#ifndef SIMPLE_SOFTWARE_H_
+#define SIMPLE_SOFTWARE_H_
+
+#include <stdint.h>
+#include "./la.h"
+#include "simple_renderer.h"
+
+// CPU backend of the Simple_Renderer for hosts without a GPU. Rasterizes the same
+// triangles and quads the GL backend draws, shading them like shaders/simple_uber.frag,
+// into an RGBA8 framebuffer. The screen is split into horizontal bands that are
+// rasterized in parallel, each band by a single thread, so blending stays in order.
+typedef struct Simple_Software Simple_Software;
+
+Simple_Software *simple_software_create(void);
+void simple_software_destroy(Simple_Software *sw);
+void simple_software_set_atlas(Simple_Software *sw, const uint8_t *pixels, size_t width, size_t height);
+void simple_software_resize(Simple_Software *sw, int width, int height);
+void simple_software_clear(Simple_Software *sw, Vec4f color);
+// Rasterizes the pending verticies and quads of sr, the triangles first just like the GL backend
+void simple_software_draw(Simple_Software *sw, const Simple_Renderer *sr);
+// RGBA8, top row first, as big as the last simple_software_resize()
+const uint8_t *simple_software_pixels(const Simple_Software *sw);
+
+#endif // SIMPLE_SOFTWARE_H_
@@ -0,0 +1,31 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// Timeline markers in the Chrome trace event format, viewable in chrome://tracing or
+// https://ui.perfetto.dev. Compiled out unless built with -DDETEY_TRACE (`TRACE=1 ./build.sh`).
+//
+// Every TRACE_BEGIN() must be matched by a TRACE_END() with the same name in the same scope
+// on every path out of it. The names must be string literals, only the pointers are recorded.
+
+#define TRACE_FILE_PATH "detey-trace.json"
+
+#ifdef DETEY_TRACE
+
+void trace_begin(const char *name);
+void trace_end(const char *name);
+// Writes the last events recorded by each of the threads. Safe to call while they keep recording.
+void trace_dump(const char *file_path);
+
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END(name) trace_end(name)
+#define TRACE_DUMP() trace_dump(TRACE_FILE_PATH)
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_DUMP() ((void)0)
+
+#endif // DETEY_TRACE
+
+#endif // TRACE_H_
@@ -0,0 +1,49 @@
+#version 330 core
+
+uniform vec2 resolution;
+uniform float time;
+uniform float camera_scale;
+uniform vec2 camera_pos;
+
+layout(std140) uniform Glyph_Metrics {
+    vec4 glyph_rect[128]; // left bearing, top bearing, width, height
+    vec4 glyph_uv[128];   // u, v, width, height
+};
+
+// Must match SIMPLE_QUAD_NO_GLYPH
+#define NO_GLYPH 65535u
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 size;
+layout(location = 2) in vec4 color;
+layout(location = 3) in uint glyph;
+layout(location = 4) in uint shader;
+
+out vec4 out_color;
+out vec2 out_uv;
+flat out uint out_shader;
+
+vec2 camera_project(vec2 point)
+{
+    return 2.0 * (point - camera_pos) * camera_scale / resolution;
+}
+
+// 2-3
+// |\|
+// 0-1
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 p;
+    if (glyph == NO_GLYPH) {
+        p = position + corner * size;
+        out_uv = vec2(0.0);
+    } else {
+        vec4 rect = glyph_rect[glyph];
+        vec4 uv = glyph_uv[glyph];
+        p = position + rect.xy + corner * vec2(rect.z, -rect.w);
+        out_uv = uv.xy + corner * uv.zw;
+    }
+    gl_Position = vec4(camera_project(p), 0, 1);
+    out_color = color;
+    out_shader = shader;
+}
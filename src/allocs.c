@@ -0,0 +1,95 @@
+#include <errno.h>
+#include <stdio.h>
+#include "allocs.h"
+#include "common.h"
+
+#ifndef __GLIBC__
+#error "Counting the allocations relies on glibc"
+#endif // __GLIBC__
+
+// The allocator of glibc under its internal names, what the wrappers forward to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+// The background threads allocate as they please, only the frame loop has to stay clean
+static _Thread_local size_t allocs = 0;
+
+static struct
+{
+    size_t frames;
+    size_t begin; // allocs_count() at the start of the current frame
+    size_t total;
+    size_t allocating;
+    size_t idle;
+    size_t idle_allocating;
+} allocs_frames = {0};
+
+size_t allocs_count(void)
+{
+    return allocs;
+}
+
+void allocs_frame_begin(void)
+{
+    allocs_frames.begin = allocs;
+}
+
+void allocs_frame_end(bool input)
+{
+    allocs_frames.frames += 1;
+    // Everything sizes itself up during the first frames
+    if (allocs_frames.frames <= FPS) return;
+
+    size_t n = allocs - allocs_frames.begin;
+    allocs_frames.total += n;
+    if (n > 0) allocs_frames.allocating += 1;
+    if (!input) {
+        allocs_frames.idle += 1;
+        if (n > 0) allocs_frames.idle_allocating += 1;
+    }
+}
+
+void allocs_report(void)
+{
+    if (allocs_frames.frames <= FPS) return;
+
+    printf("allocs: %zu allocations in %zu of %zu frames after the first %d, %zu of the %zu frames without any input allocated\n",
+           allocs_frames.total, allocs_frames.allocating, allocs_frames.frames - FPS, FPS,
+           allocs_frames.idle_allocating, allocs_frames.idle);
+}
+
+void *malloc(size_t size)
+{
+    allocs += 1;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocs += 1;
+    return __libc_calloc(count, size);
+}
+
+// Every realloc() counts, the ones that fit in place still walk the allocator
+void *realloc(void *ptr, size_t size)
+{
+    allocs += 1;
+    return __libc_realloc(ptr, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    allocs += 1;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    allocs += 1;
+    void *result = __libc_memalign(alignment, size);
+    if (result == NULL) return ENOMEM;
+    *ptr = result;
+    return 0;
+}
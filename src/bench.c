@@ -0,0 +1,611 @@
+// mkdtemp() is not visible with -std=c11 otherwise
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <SDL2/SDL.h>
+
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+
+#include "common.h"
+#include "editor.h"
+#include "buffers.h"
+#include "file_browser.h"
+#include "free_glyph.h"
+#include "lexer.h"
+#include "sv.h"
+
+// Microbenchmarks of the editor core on generated corpora: `./build.sh bench && ./detey-bench`.
+// Prints one tab separated line per benchmark, so the results of two releases can be diffed
+// or loaded into anything that reads TSV. The corpora come from a fixed seed, every run
+// measures the exact same input.
+
+#define BENCH_SAMPLES 5
+// Every sample repeats the benchmark at least this long to amortize the timer
+#define BENCH_SAMPLE_SECONDS 0.05
+// The editor keeps a 40 byte Token per few bytes of text, 1 GB of it needs a big machine
+#define BENCH_DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+#define BENCH_MEASURE_MAX_SIZE (1024 * 1024)
+#define BENCH_PATHS_COUNT 4096
+// The memory of the file browser is checked over a walk through a generated tree of this many
+// sibling directories, each of them this deep, and it may only grow this much during it
+#define BENCH_LISTINGS_SIBLINGS 100
+#define BENCH_LISTINGS_DEPTH 100
+#define BENCH_LISTINGS_MAX_GROWTH_KB 256
+// How many files of the source tree are open for switching between them
+#define BENCH_BUFFERS_COUNT 20
+
+static const size_t bench_sizes[] = {
+    1024,
+    64 * 1024,
+    1024 * 1024,
+    16 * 1024 * 1024,
+    256 * 1024 * 1024,
+    1024 * 1024 * 1024,
+};
+#define BENCH_SIZES_COUNT (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static Free_Glyph_Atlas atlas = {0};
+
+typedef struct
+{
+    const char *filter;
+    size_t max_size;
+
+    String_Builder corpus;
+    Editor editor;
+    bool minified; // the editor holds the corpus with all of its lines joined into one
+    String_Builder paths; // BENCH_PATHS_COUNT paths, each of them followed by a '\n'
+    String_Builder normalized;
+    File_Browser fb;
+    String_Builder patched; // what editor_patch swaps in and out of the editor
+    Simple_Renderer sr; // only its camera, which the buffers take along
+
+    Uint64 untimed; // ticks spent on setup inside of a Bench_Func, not counted towards the sample
+    size_t sink; // results of the benchmarked calls go here, so they are not optimized away
+} Bench;
+
+// Runs the benchmark `iterations` times on the input of the given size and
+// returns how many bytes of input were processed per iteration, 0 for lookups
+// that do not depend on the size of the input
+typedef size_t (*Bench_Func)(Bench *b, size_t size, size_t iterations);
+
+// xorshift32, the corpora must not depend on the libc
+static uint32_t bench_random(void)
+{
+    static uint32_t state = 0x2545F491;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+#define bench_pick(words) ((words)[bench_random() % (sizeof(words) / sizeof((words)[0]))])
+
+// Something that looks like C to the lexer, with every kind of token on lines of varying length
+static void bench_generate_corpus(String_Builder *sb, size_t size)
+{
+    static const char *keywords[] = {"int", "for", "while", "return", "static", "const", "if", "else", "struct", "size_t"};
+    static const char *symbols[] = {"editor", "cursor", "data", "count", "items", "line", "x", "pos", "result", "atlas"};
+    static const char *operators[] = {"=", "+", "-", "*", "<", "==", "!=", "+=", "->", "&&"};
+    static const char *lines[] = {
+        "#include <stdio.h>\n",
+        "// TODO: this comment is here just to be skipped by the lexer\n",
+        "    printf(\"%zu items\\n\", count);\n",
+        "}\n",
+        "\n",
+    };
+
+    sb->count = 0;
+    while (sb->count < size) {
+        if (bench_random() % 4 == 0) {
+            sb_append_cstr(sb, bench_pick(lines));
+            continue;
+        }
+
+        sb_append_cstr(sb, "    ");
+        size_t words = 2 + bench_random() % 8;
+        for (size_t i = 0; i < words; ++i) {
+            char number[16];
+            switch (bench_random() % 4) {
+            case 0: sb_append_cstr(sb, bench_pick(keywords)); break;
+            case 1: sb_append_cstr(sb, bench_pick(symbols)); break;
+            case 2: sb_append_cstr(sb, bench_pick(operators)); break;
+            default:
+                snprintf(number, sizeof(number), "%u", bench_random() % 100000);
+                sb_append_cstr(sb, number);
+            }
+            sb_append_cstr(sb, i + 1 < words ? " " : ";\n");
+        }
+    }
+    sb->count = size;
+}
+
+// Paths the file browser produces while walking around, with `.`, `..` and repeated slashes
+static void bench_generate_paths(String_Builder *sb)
+{
+    static const char *comps[] = {"src", "include", "..", ".", "", "fonts", "detey", "home", "user", ".."};
+
+    sb->count = 0;
+    for (size_t i = 0; i < BENCH_PATHS_COUNT; ++i) {
+        if (bench_random() % 2 == 0) sb_append_cstr(sb, "/");
+        size_t n = 1 + bench_random() % 12;
+        for (size_t j = 0; j < n; ++j) {
+            if (j > 0) sb_append_cstr(sb, "/");
+            sb_append_cstr(sb, bench_pick(comps));
+        }
+        sb_append_cstr(sb, "\n");
+    }
+}
+
+static void bench_load_editor(Bench *b, size_t size, bool minified)
+{
+    if (b->editor.data.count == size && b->minified == minified) return;
+
+    b->editor.data.count = 0;
+    sb_append_buf(&b->editor.data, b->corpus.items, size);
+    if (minified) {
+        for (size_t i = 0; i < size; ++i) {
+            if (b->editor.data.items[i] == '\n') b->editor.data.items[i] = ' ';
+        }
+    }
+    b->minified = minified;
+    b->editor.cursor = 0;
+    b->editor.searching = false;
+    editor_retokenize(&b->editor);
+}
+
+static size_t bench_lexer_next(Bench *b, size_t size, size_t iterations)
+{
+    for (size_t i = 0; i < iterations; ++i) {
+        Lexer l = lexer_new(&atlas, b->corpus.items, size);
+        Token t = lexer_next(&l);
+        while (t.kind != TOKEN_END) {
+            b->sink += t.text_len;
+            t = lexer_next(&l);
+        }
+    }
+    return size;
+}
+
+static size_t bench_editor_retokenize(Bench *b, size_t size, size_t iterations)
+{
+    bench_load_editor(b, size, false);
+    for (size_t i = 0; i < iterations; ++i) {
+        editor_retokenize(&b->editor);
+        b->sink += b->editor.tokens.count;
+    }
+    return size;
+}
+
+// One character changed in the middle of the file, as when another program touches one line
+static size_t bench_editor_patch(Bench *b, size_t size, size_t iterations)
+{
+    bench_load_editor(b, size, false);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    b->patched.count = 0;
+    sb_append_buf(&b->patched, b->editor.data.items, size / 2);
+    sb_append_cstr(&b->patched, "x");
+    sb_append_buf(&b->patched, b->editor.data.items + size / 2, size - size / 2);
+    b->untimed += SDL_GetPerformanceCounter() - start;
+
+    // Every patch swaps the previous contents into b->patched, so the iterations go back and forth
+    for (size_t i = 0; i < iterations; ++i) {
+        editor_patch(&b->editor, &b->patched);
+        b->sink += b->editor.tokens.count;
+        frame_reset();
+    }
+    return size;
+}
+
+static size_t bench_editor_insert_buf(Bench *b, size_t size, size_t iterations, size_t cursor)
+{
+    bench_load_editor(b, size, false);
+    char c = 'x';
+    for (size_t i = 0; i < iterations; ++i) {
+        b->editor.cursor = cursor;
+        editor_insert_buf(&b->editor, &c, 1);
+        b->sink += b->editor.cursor;
+
+        // Take the character back out, so every iteration inserts into the same buffer
+        Uint64 start = SDL_GetPerformanceCounter();
+        String_Builder *data = &b->editor.data;
+        memmove(&data->items[cursor], &data->items[cursor + 1], data->count - cursor - 1);
+        data->count -= 1;
+        b->untimed += SDL_GetPerformanceCounter() - start;
+    }
+    return size;
+}
+
+static size_t bench_editor_insert_buf_start(Bench *b, size_t size, size_t iterations)
+{
+    return bench_editor_insert_buf(b, size, iterations, 0);
+}
+
+static size_t bench_editor_insert_buf_middle(Bench *b, size_t size, size_t iterations)
+{
+    return bench_editor_insert_buf(b, size, iterations, size / 2);
+}
+
+static size_t bench_editor_insert_buf_end(Bench *b, size_t size, size_t iterations)
+{
+    return bench_editor_insert_buf(b, size, iterations, size);
+}
+
+// The scan editor_start_search() does for a word that is not in the buffer
+static size_t bench_editor_search_matches_at(Bench *b, size_t size, size_t iterations)
+{
+    bench_load_editor(b, size, false);
+    b->editor.search.count = 0;
+    sb_append_cstr(&b->editor.search, "editor_missing");
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t pos = 0; pos < b->editor.data.count; ++pos) {
+            if (editor_search_matches_at(&b->editor, pos)) b->sink += pos;
+        }
+    }
+    return size;
+}
+
+// Where the cursor goes at the end of a minified file, that used to be a walk over the whole line
+static size_t bench_editor_line_x(Bench *b, size_t size, size_t iterations)
+{
+    bench_load_editor(b, size, true);
+    for (size_t i = 0; i < iterations; ++i) {
+        b->sink += (size_t)editor_line_x(&b->editor, 0, size - i % 2);
+    }
+    return 0;
+}
+
+static size_t bench_free_glyph_atlas_measure_line_sized(Bench *b, size_t size, size_t iterations)
+{
+    for (size_t i = 0; i < iterations; ++i) {
+        Vec2f pos = vec2fs(0.0f);
+        free_glyph_atlas_measure_line_sized(&atlas, b->corpus.items, size, &pos);
+        b->sink += (size_t)pos.x;
+    }
+    return size;
+}
+
+// Normalizes all of the generated paths, the size is ignored
+static size_t bench_normpath(Bench *b, size_t size, size_t iterations)
+{
+    UNUSED(size);
+    for (size_t i = 0; i < iterations; ++i) {
+        String_View paths = sb_to_sv(b->paths);
+        while (paths.count > 0) {
+            String_View path = sv_chop_by_delim(&paths, '\n');
+            b->normalized.count = 0;
+            normpath(path, &b->normalized);
+            b->sink += b->normalized.count;
+        }
+        frame_reset();
+    }
+    return b->paths.count;
+}
+
+// Lists the current directory and its parent in turns, the size is ignored
+static size_t bench_fb_open_dir(Bench *b, size_t size, size_t iterations)
+{
+    UNUSED(size);
+    for (size_t i = 0; i < iterations; ++i) {
+        Errno err = fb_open_dir(&b->fb, i % 2 == 0 ? "." : "..");
+        assert(err == 0);
+        b->sink += b->fb.files.count;
+    }
+    return 0;
+}
+
+// Resident memory of the process in KB, 0 where it is not known
+static size_t bench_rss_kb(void)
+{
+    size_t rss = 0;
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL) return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "VmRSS: %zu kB", &rss) == 1) break;
+    }
+    fclose(f);
+#endif // __linux__
+    return rss;
+}
+
+#ifndef _WIN32
+// BENCH_LISTINGS_SIBLINGS directories d00, d01, ... with a chain of BENCH_LISTINGS_DEPTH
+// directories n/n/n/... in each of them. Removes it instead when remove is true.
+static bool bench_listings_tree(const char *root, bool remove)
+{
+    String_Builder path = {0};
+    bool ok = true;
+    for (size_t i = 0; i < BENCH_LISTINGS_SIBLINGS && ok; ++i) {
+        path.count = 0;
+        sb_append_cstr(&path, frame_sprintf("%s/d%02zu", root, i));
+        for (size_t depth = 0; depth < BENCH_LISTINGS_DEPTH; ++depth) {
+            if (depth > 0) sb_append_cstr(&path, "/n");
+            if (remove) continue;
+            sb_append_null(&path);
+            ok = ok && mkdir(path.items, 0755) == 0;
+            path.count -= 1;
+        }
+        for (size_t depth = 0; remove && depth < BENCH_LISTINGS_DEPTH; ++depth) {
+            sb_append_null(&path);
+            rmdir(path.items);
+            path.count -= depth + 1 < BENCH_LISTINGS_DEPTH ? 3 : 1;
+        }
+        frame_reset();
+    }
+    if (remove) rmdir(root);
+    free(path.items);
+    return ok;
+}
+
+static Errno bench_fb_enter(File_Browser *fb, const char *name)
+{
+    for (fb->cursor = 0; fb->cursor < fb->files.count; ++fb->cursor) {
+        if (strcmp(fb->files.items[fb->cursor].name->data, name) == 0) break;
+    }
+    if (fb->cursor >= fb->files.count) return ENOENT;
+    Errno err = fb_change_dir(fb);
+    // Once per directory like the main loop does it once per frame
+    frame_reset();
+    return err;
+}
+
+// Goes down every chain of the tree with fb_change_dir() and all the way back up through `..`,
+// starting and ending at the root of the tree
+static Errno bench_walk_listings(Bench *b)
+{
+    Errno err = 0;
+    for (size_t i = 0; i < BENCH_LISTINGS_SIBLINGS; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "d%02zu", i);
+        if ((err = bench_fb_enter(&b->fb, name)) != 0) return err;
+        for (size_t depth = 1; depth < BENCH_LISTINGS_DEPTH; ++depth) {
+            if ((err = bench_fb_enter(&b->fb, "n")) != 0) return err;
+        }
+        for (size_t depth = 0; depth < BENCH_LISTINGS_DEPTH; ++depth) {
+            if ((err = bench_fb_enter(&b->fb, "..")) != 0) return err;
+        }
+        b->sink += b->fb.files.count;
+    }
+    return 0;
+}
+#endif // _WIN32
+
+// Walks through BENCH_LISTINGS_SIBLINGS * BENCH_LISTINGS_DEPTH directories the way the user
+// does, the file browser must not hold on to anything of the ones it left
+static bool bench_check_listings_memory(Bench *b)
+{
+#ifdef _WIN32
+    UNUSED(b);
+    return true;
+#else
+    char root[] = "/tmp/detey-bench-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        fprintf(stderr, "ERROR: Could not create a temporary directory: %s\n", strerror(errno));
+        return false;
+    }
+
+    bool ok = bench_listings_tree(root, false);
+    if (!ok) fprintf(stderr, "ERROR: Could not create the directories in %s: %s\n", root, strerror(errno));
+
+    // The first walk sizes up the arrays and the arenas. Nothing is reset in between, the
+    // second walk has to get by with the memory of the first one.
+    Errno err = ok ? fb_open_dir(&b->fb, root) : 0;
+    if (ok && err == 0) err = bench_walk_listings(b);
+    size_t before = bench_rss_kb();
+    if (ok && err == 0) err = bench_walk_listings(b);
+    size_t after = bench_rss_kb();
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not walk %s: %s\n", root, strerror(err));
+        ok = false;
+    }
+
+    // Back where it started, with every `..` collapsed
+    if (ok && strcmp(b->fb.dir_path.items, root) != 0) {
+        fprintf(stderr, "ERROR: the file browser ended up in %s instead of %s\n", b->fb.dir_path.items, root);
+        ok = false;
+    }
+
+    size_t growth = after > before ? after - before : 0;
+    if (ok && before != 0) {
+        fprintf(stderr, "fb_change_dir: RSS grew by %zu KB over %d directories\n",
+                growth, BENCH_LISTINGS_SIBLINGS * BENCH_LISTINGS_DEPTH);
+        if (growth > BENCH_LISTINGS_MAX_GROWTH_KB) {
+            fprintf(stderr, "ERROR: the file browser leaks memory with every directory it lists\n");
+            ok = false;
+        }
+    }
+
+    bench_listings_tree(root, true);
+    return ok;
+#endif // _WIN32
+}
+
+// Opens BENCH_BUFFERS_COUNT files of src/ and include/ once, run from the root of the repo
+static void bench_open_buffers(Bench *b)
+{
+    if (buffers_count() > 1) return;
+
+    static const char *dirs[] = {"src", "include"};
+    for (size_t d = 0; d < sizeof(dirs) / sizeof(dirs[0]); ++d) {
+        Errno err = fb_open_dir(&b->fb, dirs[d]);
+        assert(err == 0);
+        for (size_t i = 0; i < b->fb.files.count && buffers_count() < BENCH_BUFFERS_COUNT; ++i) {
+            const File_Entry *entry = &b->fb.files.items[i];
+            if (entry->type != FT_REGULAR) continue;
+            err = buffers_open(frame_sprintf("%s/%s", dirs[d], entry->name->data), &b->sr);
+            assert(err == 0);
+        }
+        frame_reset();
+    }
+}
+
+// Goes round the open files, all of which keep their tokens within the default budget
+static size_t bench_buffers_switch(Bench *b, size_t size, size_t iterations)
+{
+    UNUSED(size);
+    bench_open_buffers(b);
+    for (size_t i = 0; i < iterations; ++i) {
+        buffers_switch(1, &b->sr);
+        b->sink += buffers_current()->tokens.count;
+    }
+    return 0;
+}
+
+// The same without any budget, every switch lexes the file again
+static size_t bench_buffers_switch_dropped(Bench *b, size_t size, size_t iterations)
+{
+    UNUSED(size);
+    bench_open_buffers(b);
+    buffers_set_budget(0);
+    for (size_t i = 0; i < iterations; ++i) {
+        buffers_switch(1, &b->sr);
+        b->sink += buffers_current()->tokens.count;
+        frame_reset();
+    }
+    buffers_set_budget((size_t)BUFFERS_DEFAULT_BUDGET_MB * 1024 * 1024);
+    return 0;
+}
+
+static double bench_seconds(Uint64 ticks)
+{
+    return (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+static int bench_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_run(Bench *b, const char *name, Bench_Func func, size_t size)
+{
+    if (b->filter != NULL && strstr(name, b->filter) == NULL) return;
+
+    // Warm up and find out how many iterations fill up a sample
+    size_t iterations = 1;
+    for (;;) {
+        b->untimed = 0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        func(b, size, iterations);
+        double seconds = bench_seconds(SDL_GetPerformanceCounter() - start - b->untimed);
+        if (seconds >= BENCH_SAMPLE_SECONDS) break;
+        iterations *= 2;
+    }
+
+    double samples[BENCH_SAMPLES];
+    size_t bytes = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; ++i) {
+        b->untimed = 0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        bytes = func(b, size, iterations);
+        samples[i] = bench_seconds(SDL_GetPerformanceCounter() - start - b->untimed) * 1e9 / (double)iterations;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(samples[0]), bench_compare_doubles);
+
+    double median_ns = samples[BENCH_SAMPLES / 2];
+    printf("%s\t%zu\t%zu\t%.1f\t%.1f\t%.2f\n",
+           name, size, iterations, median_ns, samples[0],
+           (double)bytes / (median_ns / 1e9) / (1024.0 * 1024.0));
+    fflush(stdout);
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--check] [--filter <substring>] [--max-size <bytes>]\n", program);
+    fprintf(stderr, "    --check               only run the checks, which every run starts with\n");
+    fprintf(stderr, "    --filter <substring>  run only the benchmarks with the substring in their name\n");
+    fprintf(stderr, "    --max-size <bytes>    the biggest corpus to generate, up to 1 GB (default %d)\n", BENCH_DEFAULT_MAX_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    static Bench b = {0};
+    b.max_size = BENCH_DEFAULT_MAX_SIZE;
+    bool check_only = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check_only = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            b.filter = argv[++i];
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            b.max_size = strtoull(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Not behind the filter, a failed check is worth more than the numbers
+    if (!bench_check_listings_memory(&b)) return 1;
+    if (check_only) return 0;
+
+    FT_Library library = {0};
+    FT_Error error = FT_Init_FreeType(&library);
+    if (error) {
+        fprintf(stderr, "ERROR: Could not initialize FreeType2 library\n");
+        return 1;
+    }
+
+    const char *const font_file_path = "./fonts/droid-sans-mono.ttf";
+    FT_Face face;
+    error = FT_New_Face(library, font_file_path, 0, &face);
+    if (error) {
+        fprintf(stderr, "ERROR: Could not load file `%s`\n", font_file_path);
+        return 1;
+    }
+    error = FT_Set_Pixel_Sizes(face, 0, FREE_GLYPH_FONT_SIZE);
+    if (error) {
+        fprintf(stderr, "ERROR: Could not set pixel size to %u\n", FREE_GLYPH_FONT_SIZE);
+        return 1;
+    }
+    free_glyph_atlas_init(&atlas, face, font_file_path);
+    b.editor.atlas = &atlas;
+    buffers_init(&atlas);
+
+    size_t max_size = 0;
+    for (size_t i = 0; i < BENCH_SIZES_COUNT; ++i) {
+        if (bench_sizes[i] <= b.max_size) max_size = bench_sizes[i];
+    }
+    bench_generate_corpus(&b.corpus, max_size);
+    bench_generate_paths(&b.paths);
+
+    printf("benchmark\tsize\titerations\tmedian_ns\tmin_ns\tmb_per_s\n");
+
+    for (size_t i = 0; i < BENCH_SIZES_COUNT && bench_sizes[i] <= max_size; ++i) {
+        size_t size = bench_sizes[i];
+        bench_run(&b, "lexer_next", bench_lexer_next, size);
+        bench_run(&b, "editor_retokenize", bench_editor_retokenize, size);
+        bench_run(&b, "editor_patch", bench_editor_patch, size);
+        bench_run(&b, "editor_insert_buf/start", bench_editor_insert_buf_start, size);
+        bench_run(&b, "editor_insert_buf/middle", bench_editor_insert_buf_middle, size);
+        bench_run(&b, "editor_insert_buf/end", bench_editor_insert_buf_end, size);
+        bench_run(&b, "editor_search_matches_at", bench_editor_search_matches_at, size);
+        if (size <= BENCH_MEASURE_MAX_SIZE) {
+            bench_run(&b, "free_glyph_atlas_measure_line_sized", bench_free_glyph_atlas_measure_line_sized, size);
+        }
+        bench_run(&b, "editor_line_x", bench_editor_line_x, size);
+    }
+    bench_run(&b, "normpath", bench_normpath, BENCH_PATHS_COUNT);
+    bench_run(&b, "fb_open_dir", bench_fb_open_dir, 0);
+    bench_run(&b, "buffers_switch", bench_buffers_switch, 0);
+    bench_run(&b, "buffers_switch/dropped", bench_buffers_switch_dropped, 0);
+
+    if (b.sink == 0) fprintf(stderr, "WARNING: the benchmarks did not do anything\n");
+    return 0;
+}
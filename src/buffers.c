@@ -0,0 +1,853 @@
+// getcwd() is not visible with -std=c11 otherwise
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+#include "buffers.h"
+#include "file_browser.h"
+#include "sv.h"
+#include "trace.h"
+
+// The tabs are laid out in screen pixels along the bottom of the window, the text is the atlas
+// scaled down to this
+#define BUFFERS_SCALE 0.3f
+#define BUFFERS_PADDING 8.0f
+#define BUFFERS_TAB_HEIGHT (FREE_GLYPH_FONT_SIZE * BUFFERS_SCALE * 1.4f)
+#define BUFFERS_VIEWS_CAP 8
+// Between the views in pixels, the focused one is marked along its top edge
+#define BUFFERS_DIVIDER 2.0f
+
+// A window into a buffer. The views of a buffer share its Editor and so its lines, tokens
+// and layouts, only the cursor and the camera are their own. The focused view keeps its cursor
+// in the Editor for the editing to work on, the others keep theirs here.
+typedef struct
+{
+    // The part of the window the view takes up, in [0, 1] along x and y. The edges it shares
+    // with its neighbours are copies of the same floats, so they compare equal.
+    float min[2];
+    float max[2];
+
+    size_t cursor;
+    size_t select_begin;
+    bool selection;
+
+    // The camera of the renderer as of the last frame the view was on the screen
+    bool has_camera;
+    Vec2f camera_pos;
+    Vec2f camera_vel;
+    float camera_scale;
+    float camera_scale_vel;
+} View;
+
+typedef struct
+{
+    Editor editor;
+    bool dropped; // its lines, tokens and layout, to stay within the budget
+    size_t last_used;
+
+    View views[BUFFERS_VIEWS_CAP];
+    size_t views_count;
+    size_t focus;
+} Buffer;
+
+// Pointers, since the reload threads of the editors hold on to them
+typedef struct
+{
+    Buffer **items;
+    size_t count;
+    size_t capacity;
+} Buffer_List;
+
+static struct
+{
+    Free_Glyph_Atlas *atlas;
+    size_t budget;
+    Buffer_List list;
+    size_t current;
+    size_t clock; // ticks on every switch, for finding the least recently used buffers
+    String_Builder path;
+} buffers = {0};
+
+static Buffer *buffer_new(void)
+{
+    Buffer *b = calloc(1, sizeof(*b));
+    assert(b != NULL && "Buy more RAM lol");
+    b->editor.atlas = buffers.atlas;
+    editor_retokenize(&b->editor);
+    b->views[0] = (View) {.min = {0.0f, 0.0f}, .max = {1.0f, 1.0f}};
+    b->views_count = 1;
+    return b;
+}
+
+static void view_save_camera(View *v, const Simple_Renderer *sr)
+{
+    v->has_camera = true;
+    v->camera_pos = sr->camera_pos;
+    v->camera_vel = sr->camera_vel;
+    v->camera_scale = sr->camera_scale;
+    v->camera_scale_vel = sr->camera_scale_vel;
+}
+
+static void view_load_camera(const View *v, Simple_Renderer *sr)
+{
+    if (!v->has_camera) return;
+    sr->camera_pos = v->camera_pos;
+    sr->camera_vel = v->camera_vel;
+    sr->camera_scale = v->camera_scale;
+    sr->camera_scale_vel = v->camera_scale_vel;
+}
+
+// Trades the cursor of the view with the one in the editor
+static void view_swap_cursor(View *v, Editor *e)
+{
+    SWAP(size_t, v->cursor, e->cursor);
+    SWAP(size_t, v->select_begin, e->select_begin);
+    SWAP(bool, v->selection, e->selection);
+}
+
+static void buffer_free(Buffer *b)
+{
+    editor_free(&b->editor);
+    free(b);
+}
+
+// The empty buffer the editor starts with, nobody is going to miss it
+static bool buffer_pristine(const Buffer *b)
+{
+    return b->editor.file_path.count == 0 && b->editor.data.count == 0;
+}
+
+static bool buffer_dirty(const Buffer *b)
+{
+    const Editor *e = &b->editor;
+    if (e->file_path.count == 0) return e->data.count > 0;
+    return hash_bytes(e->data.items, e->data.count) != e->file_hash;
+}
+
+// Drops the derived data of the least recently used inactive buffers until the rest fits
+static void buffers_enforce_budget(void)
+{
+    for (;;) {
+        size_t total = 0;
+        Buffer *lru = NULL;
+        for (size_t i = 0; i < buffers.list.count; ++i) {
+            Buffer *b = buffers.list.items[i];
+            if (i == buffers.current || b->dropped) continue;
+            total += editor_derived_size(&b->editor);
+            if (lru == NULL || b->last_used < lru->last_used) lru = b;
+        }
+        if (lru == NULL || total <= buffers.budget) return;
+
+        editor_drop_derived(&lru->editor);
+        lru->dropped = true;
+    }
+}
+
+static void buffers_enter(size_t index, Simple_Renderer *sr)
+{
+    Buffer *b = buffers.list.items[index];
+    buffers.current = index;
+    b->last_used = ++buffers.clock;
+
+    if (b->dropped) {
+        editor_retokenize(&b->editor);
+        b->dropped = false;
+        // Whatever happened to the file in the meantime is still queued up in its watch
+        editor_poll_changes(&b->editor);
+    }
+
+    view_load_camera(&b->views[b->focus], sr);
+    buffers_enforce_budget();
+}
+
+void buffers_init(Free_Glyph_Atlas *atlas)
+{
+    assert(buffers.list.count == 0);
+    buffers.atlas = atlas;
+    buffers.budget = (size_t)BUFFERS_DEFAULT_BUDGET_MB * 1024 * 1024;
+    da_append(&buffers.list, buffer_new());
+    buffers.current = 0;
+}
+
+void buffers_set_budget(size_t budget)
+{
+    buffers.budget = budget;
+    buffers_enforce_budget();
+}
+
+Editor *buffers_current(void)
+{
+    assert(buffers.current < buffers.list.count && "You need to call buffers_init() first");
+    return &buffers.list.items[buffers.current]->editor;
+}
+
+size_t buffers_count(void)
+{
+    return buffers.list.count;
+}
+
+Errno buffers_open(const char *file_path, Simple_Renderer *sr)
+{
+    // The browser and the finder spell the same file differently
+    buffers.path.count = 0;
+    normpath(sv_from_cstr(file_path), &buffers.path);
+    sb_append_null(&buffers.path);
+
+    for (size_t i = 0; i < buffers.list.count; ++i) {
+        const Editor *e = &buffers.list.items[i]->editor;
+        if (e->file_path.count > 0 && strcmp(e->file_path.items, buffers.path.items) == 0) {
+            buffers_enter(i, sr);
+            return 0;
+        }
+    }
+
+    Buffer *current = buffers.list.items[buffers.current];
+    Buffer *b = buffer_pristine(current) ? current : buffer_new();
+    Errno err = editor_load_from_file(&b->editor, buffers.path.items);
+    if (err != 0) {
+        if (b != current) buffer_free(b);
+        return err;
+    }
+
+    if (b == current) {
+        b->last_used = ++buffers.clock;
+    } else {
+        da_append(&buffers.list, b);
+        buffers_enter(buffers.list.count - 1, sr);
+    }
+    return 0;
+}
+
+void buffers_switch(int delta, Simple_Renderer *sr)
+{
+    size_t count = buffers.list.count;
+    if (count < 2) return;
+
+    long index = ((long)buffers.current + delta % (long)count + (long)count) % (long)count;
+    buffers_enter((size_t)index, sr);
+}
+
+bool buffers_close(Simple_Renderer *sr)
+{
+    Buffer *b = buffers.list.items[buffers.current];
+    if (buffer_dirty(b)) {
+        fprintf(stderr, "WARNING: %s has unsaved changes, save it before closing\n",
+                b->editor.file_path.count > 0 ? b->editor.file_path.items : "The buffer");
+        return false;
+    }
+
+    buffer_free(b);
+    if (buffers.list.count == 1) {
+        buffers.list.items[0] = buffer_new();
+        return true;
+    }
+
+    memmove(buffers.list.items + buffers.current,
+            buffers.list.items + buffers.current + 1,
+            (buffers.list.count - buffers.current - 1) * sizeof(*buffers.list.items));
+    buffers.list.count -= 1;
+
+    // Back to where the user was before
+    size_t mru = 0;
+    for (size_t i = 1; i < buffers.list.count; ++i) {
+        if (buffers.list.items[i]->last_used > buffers.list.items[mru]->last_used) mru = i;
+    }
+    buffers_enter(mru, sr);
+    return true;
+}
+
+// Where a position ends up after an edit at `at` that changed the size of the text from count
+static size_t track_edit(size_t pos, size_t at, size_t count, size_t new_count)
+{
+    if (new_count > count) return pos > at ? pos + (new_count - count) : pos;
+    size_t deleted = count - new_count;
+    if (pos <= at) return pos;
+    return pos >= at + deleted ? pos - deleted : at;
+}
+
+void buffers_track_edit(size_t count, size_t cursor)
+{
+    Buffer *b = buffers.list.items[buffers.current];
+    const Editor *e = &b->editor;
+    if (e->data.count == count) return;
+
+    // Insertions start at the cursor before them, deletions at the cursor after them, be it
+    // backspace or delete
+    size_t at = e->data.count > count ? cursor : e->cursor;
+    for (size_t i = 0; i < b->views_count; ++i) {
+        if (i == b->focus) continue;
+        View *v = &b->views[i];
+        v->cursor = track_edit(v->cursor, at, count, e->data.count);
+        v->select_begin = track_edit(v->select_begin, at, count, e->data.count);
+    }
+}
+
+void buffers_split(bool side_by_side)
+{
+    Buffer *b = buffers.list.items[buffers.current];
+    if (b->views_count >= BUFFERS_VIEWS_CAP) {
+        fprintf(stderr, "WARNING: Can't have more than %d views of a buffer\n", BUFFERS_VIEWS_CAP);
+        return;
+    }
+
+    View *focused = &b->views[b->focus];
+    focused->cursor = b->editor.cursor;
+    focused->select_begin = b->editor.select_begin;
+    focused->selection = b->editor.selection;
+
+    View view = *focused;
+    int axis = side_by_side ? 0 : 1;
+    float middle = 0.5f * (focused->min[axis] + focused->max[axis]);
+    focused->max[axis] = middle;
+    view.min[axis] = middle;
+
+    size_t index = b->focus + 1;
+    memmove(b->views + index + 1, b->views + index, (b->views_count - index) * sizeof(*b->views));
+    b->views[index] = view;
+    b->views_count += 1;
+    b->focus = index;
+}
+
+static bool view_next_to(const View *v, const View *closed, int axis, int side)
+{
+    int other = 1 - axis;
+    bool touching = side < 0 ? v->max[axis] == closed->min[axis] : v->min[axis] == closed->max[axis];
+    return touching && v->min[other] >= closed->min[other] && v->max[other] <= closed->max[other];
+}
+
+// Gives the space of the closed view to its neighbours on one side along the axis, if they
+// cover all of that side of it
+static bool views_fill(Buffer *b, const View *closed, int axis, int side)
+{
+    int other = 1 - axis;
+    size_t count = 0;
+    size_t joints = 0;
+    bool first = false;
+    bool last = false;
+    for (size_t i = 0; i < b->views_count; ++i) {
+        const View *v = &b->views[i];
+        if (i == b->focus || !view_next_to(v, closed, axis, side)) continue;
+        count += 1;
+        if (v->min[other] == closed->min[other]) first = true;
+        if (v->max[other] == closed->max[other]) last = true;
+        for (size_t j = 0; j < b->views_count; ++j) {
+            const View *u = &b->views[j];
+            if (j != b->focus && view_next_to(u, closed, axis, side) && v->max[other] == u->min[other]) joints += 1;
+        }
+    }
+    // Nothing overlaps, so spans that start where the side starts, end where it ends and are
+    // joined one after another cover all of it
+    if (count == 0 || !first || !last || joints != count - 1) return false;
+
+    bool focused = false;
+    for (size_t i = 0; i < b->views_count; ++i) {
+        View *v = &b->views[i];
+        if (i == b->focus || !view_next_to(v, closed, axis, side)) continue;
+        if (side < 0) v->max[axis] = closed->max[axis];
+        else v->min[axis] = closed->min[axis];
+
+        // The focus goes to one of the views that took over
+        if (!focused) {
+            view_swap_cursor(v, &b->editor);
+            b->focus = i;
+            focused = true;
+        }
+    }
+    return true;
+}
+
+void buffers_close_view(void)
+{
+    Buffer *b = buffers.list.items[buffers.current];
+    if (b->views_count < 2) return;
+
+    // The views come from splitting a view in two over and over, so the neighbours on one of
+    // the sides always line up with the closed one
+    size_t closed = b->focus;
+    View view = b->views[closed];
+    bool filled = views_fill(b, &view, 0, -1) || views_fill(b, &view, 0, 1) ||
+                  views_fill(b, &view, 1, -1) || views_fill(b, &view, 1, 1);
+    assert(filled && "The views do not tile the window");
+    UNUSED(filled);
+
+    memmove(b->views + closed, b->views + closed + 1, (b->views_count - closed - 1) * sizeof(*b->views));
+    b->views_count -= 1;
+    if (b->focus > closed) b->focus -= 1;
+}
+
+void buffers_focus_next_view(void)
+{
+    Buffer *b = buffers.list.items[buffers.current];
+    if (b->views_count < 2) return;
+    view_swap_cursor(&b->views[b->focus], &b->editor);
+    b->focus = (b->focus + 1) % b->views_count;
+    view_swap_cursor(&b->views[b->focus], &b->editor);
+}
+
+void buffers_poll_changes(void)
+{
+    for (size_t i = 0; i < buffers.list.count; ++i) {
+        Buffer *b = buffers.list.items[i];
+        if (!b->dropped) editor_poll_changes(&b->editor);
+    }
+    // A reload may have grown one of them
+    buffers_enforce_budget();
+}
+
+static const char *buffer_name(const Buffer *b)
+{
+    const Editor *e = &b->editor;
+    if (e->file_path.count == 0) return "[untitled]";
+    const char *slash = strrchr(e->file_path.items, '/');
+    return slash != NULL ? slash + 1 : e->file_path.items;
+}
+
+static float buffers_tab_width(Free_Glyph_Atlas *atlas, const char *name)
+{
+    Vec2f pos = vec2fs(0.0f);
+    free_glyph_atlas_measure_line_sized(atlas, name, strlen(name), &pos);
+    return pos.x * BUFFERS_SCALE + 2 * BUFFERS_PADDING;
+}
+
+// Pixels of the framebuffer the view takes up, less the dividers towards its neighbours
+static void view_rect(const View *v, const Simple_Renderer *sr, Vec2f *pos, Vec2f *size)
+{
+    float x0 = roundf(v->min[0] * sr->framebuffer.x);
+    float y0 = roundf(v->min[1] * sr->framebuffer.y);
+    float x1 = roundf(v->max[0] * sr->framebuffer.x);
+    float y1 = roundf(v->max[1] * sr->framebuffer.y);
+    if (v->max[0] < 1.0f) x1 -= BUFFERS_DIVIDER;
+    if (v->max[1] < 1.0f) y1 -= BUFFERS_DIVIDER;
+    *pos = vec2f(x0, y0);
+    *size = vec2f(x1 - x0, y1 - y0);
+}
+
+static void buffers_render_views(Simple_Renderer *sr, Free_Glyph_Atlas *atlas, Buffer *b)
+{
+    Editor *e = &b->editor;
+    for (size_t i = 0; i < b->views_count; ++i) {
+        View *v = &b->views[i];
+        Vec2f pos, size;
+        view_rect(v, sr, &pos, &size);
+        simple_renderer_set_viewport(sr, pos, size);
+        view_load_camera(v, sr);
+
+        if (i != b->focus) {
+            view_swap_cursor(v, e);
+            // A reload moves only the cursor of the focused view along with the text
+            if (e->cursor > e->data.count) e->cursor = e->data.count;
+            if (e->select_begin > e->data.count) e->select_begin = e->data.count;
+        }
+        editor_render(atlas, sr, e);
+        if (i != b->focus) view_swap_cursor(v, e);
+
+        view_save_camera(v, sr);
+    }
+    simple_renderer_reset_viewport(sr);
+    // Whatever comes next, such as the file browser, picks up from the focused view
+    view_load_camera(&b->views[b->focus], sr);
+}
+
+static void buffers_render_dividers(Simple_Renderer *sr, const Buffer *b)
+{
+    simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+    const Vec4f divider_color = hex_to_vec4f(0x181926ff);
+    for (size_t i = 0; i < b->views_count; ++i) {
+        const View *v = &b->views[i];
+        Vec2f pos, size;
+        view_rect(v, sr, &pos, &size);
+        if (v->max[0] < 1.0f) simple_renderer_overlay_rect(sr, pos.x + size.x, pos.y, BUFFERS_DIVIDER, size.y + BUFFERS_DIVIDER, divider_color);
+        if (v->max[1] < 1.0f) simple_renderer_overlay_rect(sr, pos.x, pos.y + size.y, size.x, BUFFERS_DIVIDER, divider_color);
+        if (i == b->focus) simple_renderer_overlay_rect(sr, pos.x, pos.y, size.x, BUFFERS_DIVIDER, hex_to_vec4f(0x8aadf4ff));
+    }
+}
+
+static void buffers_render_tabs(Simple_Renderer *sr, Free_Glyph_Atlas *atlas)
+{
+    const Buffer *current = buffers.list.items[buffers.current];
+
+    // Scrolled just enough for the current tab to be on the screen
+    float scroll = 0.0f;
+    {
+        float x = 0.0f;
+        for (size_t i = 0; i <= buffers.current; ++i) {
+            x += buffers_tab_width(atlas, buffer_name(buffers.list.items[i]));
+        }
+        if (x > sr->resolution.x) scroll = x - sr->resolution.x;
+    }
+
+    const float y = sr->resolution.y - BUFFERS_TAB_HEIGHT;
+    simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+    simple_renderer_overlay_rect(sr, 0.0f, y, sr->resolution.x, BUFFERS_TAB_HEIGHT, hex_to_vec4f(0x181926f0));
+    {
+        float x = -scroll;
+        for (size_t i = 0; i < buffers.current; ++i) {
+            x += buffers_tab_width(atlas, buffer_name(buffers.list.items[i]));
+        }
+        simple_renderer_overlay_rect(sr, x, y, buffers_tab_width(atlas, buffer_name(current)), BUFFERS_TAB_HEIGHT, hex_to_vec4f(0x494d64ff));
+    }
+
+    simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+    const Vec4f text_color = hex_to_vec4f(0xcad3f5ff);
+    const Vec4f dim_color = hex_to_vec4f(0x8087a2ff);
+    float x = -scroll;
+    for (size_t i = 0; i < buffers.list.count && x < sr->resolution.x; ++i) {
+        const Buffer *b = buffers.list.items[i];
+        const char *name = buffer_name(b);
+        float width = buffers_tab_width(atlas, name);
+        if (x + width > 0.0f) {
+            Vec2f pen = simple_renderer_overlay_point(sr, x + BUFFERS_PADDING, y + BUFFERS_TAB_HEIGHT * 0.7f);
+            free_glyph_atlas_render_line_sized(atlas, sr, name, strlen(name), &pen, b->dropped ? dim_color : text_color);
+        }
+        x += width;
+    }
+}
+
+void buffers_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas)
+{
+    Buffer *current = buffers.list.items[buffers.current];
+    if (current->views_count == 1) {
+        editor_render(atlas, sr, &current->editor);
+        view_save_camera(&current->views[0], sr);
+    } else {
+        buffers_render_views(sr, atlas, current);
+    }
+
+    if (current->views_count < 2 && buffers.list.count < 2) return;
+
+    simple_renderer_begin_overlay(sr, BUFFERS_SCALE);
+
+    if (current->views_count > 1) buffers_render_dividers(sr, current);
+    if (buffers.list.count > 1) buffers_render_tabs(sr, atlas);
+
+    simple_renderer_end_overlay(sr);
+}
+
+#define SESSION_MAGIC "DTYSESSN"
+#define SESSION_VERSION 1
+
+// Layout of the session file in the cache directory. The header is followed by a Session_Buffer
+// for every open file, which is followed by its path padded to 8 bytes and then, if the file was
+// unchanged, by where its lines begin and by its tokens. Like the atlas cache it is only read back on the same
+// machine, so the structs are written as they are.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t buffers_count;
+    uint32_t current;
+    uint32_t reserved;
+    uint64_t metrics_hash; // of the glyph metrics the tokens were positioned with
+} Session_Header;
+
+typedef struct
+{
+    uint64_t path_len;
+    File_Stamp stamp;
+    uint64_t file_hash;
+    uint64_t lines_count; // 0 when the lines and the tokens were not saved
+    uint64_t tokens_count;
+    uint32_t views_count;
+    uint32_t focus;
+    View views[BUFFERS_VIEWS_CAP]; // the focused one with the cursor of the editor
+} Session_Buffer;
+
+// A Token in half of the space, with its text as an offset into the contents
+typedef struct
+{
+    uint32_t gap; // from the text of the token before
+    uint32_t text_len_kind; // the kind in the top byte
+    Vec2f position;
+} Session_Token;
+
+#define SESSION_ALIGN(size) (((size) + 7) & ~(size_t)7)
+#define SESSION_TOKENS_BATCH 1024
+#define SESSION_TEXT_LEN_MAX ((1u << 24) - 1)
+
+// There is one session for every directory the editor is started in, the paths of the files
+// are relative to it
+static Errno session_file_path(String_Builder *path)
+{
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) return errno;
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "session-%016llx.bin", (unsigned long long)hash_bytes(cwd, strlen(cwd)));
+    return cache_file_path(file_name, path);
+}
+
+static uint64_t session_metrics_hash(void)
+{
+    return hash_bytes((const char *)buffers.atlas->metrics, sizeof(buffers.atlas->metrics));
+}
+
+static bool session_tokens_fit(const Editor *e)
+{
+    const char *prev = e->data.items;
+    for (size_t i = 0; i < e->tokens.count; ++i) {
+        const Token *t = &e->tokens.items[i];
+        if (t->text < prev || (size_t)(t->text - prev) > UINT32_MAX || t->text_len > SESSION_TEXT_LEN_MAX) return false;
+        prev = t->text;
+    }
+    return true;
+}
+
+static void session_save_buffer(String_Builder *data, const Buffer *b)
+{
+    const Editor *e = &b->editor;
+    Session_Buffer s = {0};
+    s.path_len = strlen(e->file_path.items);
+    s.file_hash = e->file_hash;
+    s.views_count = (uint32_t)b->views_count;
+    s.focus = (uint32_t)b->focus;
+    memcpy(s.views, b->views, sizeof(s.views));
+    s.views[b->focus].cursor = e->cursor;
+    s.views[b->focus].select_begin = e->select_begin;
+    s.views[b->focus].selection = e->selection;
+
+    // The tokens are only worth anything for the text that is on the disk
+    bool unchanged = !b->dropped && !buffer_dirty(b)
+        && stamp_of_file(e->file_path.items, &s.stamp) == 0 && s.stamp.size == e->data.count
+        && session_tokens_fit(e);
+    if (unchanged) {
+        s.lines_count = e->lines.count;
+        s.tokens_count = e->tokens.count;
+    }
+
+    sb_append_buf(data, (const char *)&s, sizeof(s));
+    sb_append_buf(data, e->file_path.items, s.path_len);
+    while (data->count % 8 != 0) da_append(data, '\0');
+    if (!unchanged) return;
+
+    for (size_t i = 0; i < e->lines.count; ++i) {
+        uint64_t begin = e->lines.items[i].begin;
+        sb_append_buf(data, (const char *)&begin, sizeof(begin));
+    }
+
+    // In batches, a big file has millions of them
+    Session_Token batch[SESSION_TOKENS_BATCH];
+    const char *prev = e->data.items;
+    for (size_t i = 0; i < e->tokens.count; i += SESSION_TOKENS_BATCH) {
+        size_t n = e->tokens.count - i < SESSION_TOKENS_BATCH ? e->tokens.count - i : SESSION_TOKENS_BATCH;
+        for (size_t j = 0; j < n; ++j) {
+            const Token *t = &e->tokens.items[i + j];
+            batch[j] = (Session_Token) {
+                .gap = (uint32_t)(t->text - prev),
+                .text_len_kind = (uint32_t)t->text_len | (uint32_t)t->kind << 24,
+                .position = t->position,
+            };
+            prev = t->text;
+        }
+        sb_append_buf(data, (const char *)batch, n * sizeof(*batch));
+    }
+}
+
+Errno buffers_save_session(void)
+{
+    Errno result = 0;
+    String_Builder path = {0};
+    String_Builder tmp_path = {0};
+    String_Builder data = {0};
+
+    Errno err = session_file_path(&path);
+    if (err != 0) return_defer(err);
+
+    Session_Header header = {0};
+    memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+    header.version = SESSION_VERSION;
+    header.metrics_hash = session_metrics_hash();
+    sb_append_buf(&data, (const char *)&header, sizeof(header));
+
+    // The files that were never saved are gone for good
+    for (size_t i = 0; i < buffers.list.count; ++i) {
+        const Buffer *b = buffers.list.items[i];
+        if (b->editor.file_path.count == 0) continue;
+        if (i == buffers.current) header.current = header.buffers_count;
+        session_save_buffer(&data, b);
+        header.buffers_count += 1;
+    }
+    memcpy(data.items, &header, sizeof(header));
+
+    // Write to a temporary file first, so another instance starting up never maps a half written session
+    sb_append_cstr(&tmp_path, path.items);
+    sb_append_cstr(&tmp_path, ".tmp");
+    sb_append_null(&tmp_path);
+
+    err = write_entire_file(tmp_path.items, data.items, data.count);
+    if (err == 0 && rename(tmp_path.items, path.items) < 0) err = errno;
+    if (err != 0) {
+        remove(tmp_path.items);
+        return_defer(err);
+    }
+
+defer:
+    free(data.items);
+    free(tmp_path.items);
+    free(path.items);
+    return result;
+}
+
+// Takes the lines and the tokens of the contents from the session instead of lexing them, if
+// they fit the contents
+static bool session_restore_derived(Editor *e, const uint64_t *lines, size_t lines_count, const Session_Token *tokens, size_t tokens_count)
+{
+    e->lines.count = 0;
+    e->tokens.count = 0;
+    e->layout.count = 0;
+    if (lines_count == 0 || lines[0] != 0) return false;
+
+    for (size_t i = 0; i < lines_count; ++i) {
+        Line line = {
+            .begin = lines[i],
+            .end = e->data.count,
+            .layout = LINE_NO_LAYOUT,
+        };
+        if (i + 1 < lines_count) {
+            if (lines[i + 1] <= line.begin || lines[i + 1] > e->data.count) return false;
+            line.end = lines[i + 1] - 1;
+            if (e->data.items[line.end] != '\n') return false;
+        }
+        da_append(&e->lines, line);
+    }
+
+    // Sized up front, growing millions of tokens one at a time shows up in the startup
+    if (e->tokens.capacity < tokens_count) {
+        e->tokens.capacity = tokens_count;
+        e->tokens.items = realloc(e->tokens.items, e->tokens.capacity * sizeof(*e->tokens.items));
+        assert(e->tokens.items != NULL && "Buy more RAM lol");
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < tokens_count; ++i) {
+        const Session_Token *st = &tokens[i];
+        size_t text_len = st->text_len_kind & SESSION_TEXT_LEN_MAX;
+        uint32_t kind = st->text_len_kind >> 24;
+        offset += st->gap;
+        if (offset > e->data.count || text_len > e->data.count - offset) return false;
+        // Anything else was not written by this version of the lexer
+        if (kind > TOKEN_STRING) return false;
+        Token t = {
+            .kind = (Token_Kind)kind,
+            .text = e->data.items + offset,
+            .text_len = text_len,
+            .position = st->position,
+        };
+        e->tokens.items[e->tokens.count++] = t;
+    }
+    return true;
+}
+
+static Buffer *session_restore_buffer(const Session_Buffer *s, const char *file_path, const uint64_t *lines,
+                                      const Session_Token *tokens, bool metrics_match, bool current)
+{
+    Buffer *first = buffers.list.items[0];
+    Buffer *b = buffers.list.count == 1 && buffer_pristine(first) ? first : buffer_new();
+    Editor *e = &b->editor;
+    if (editor_load_text_from_file(e, file_path) != 0) {
+        if (b != first) buffer_free(b);
+        return NULL;
+    }
+
+    // Stamped after reading, so a change to the file while it was read shows up as one
+    File_Stamp stamp = {0};
+    bool unchanged = metrics_match && s->lines_count > 0
+        && stamp_of_file(file_path, &stamp) == 0
+        && memcmp(&stamp, &s->stamp, sizeof(stamp)) == 0
+        && stamp.size == e->data.count;
+    if (unchanged && session_restore_derived(e, lines, s->lines_count, tokens, s->tokens_count)) {
+        e->file_hash = s->file_hash;
+    } else {
+        e->file_hash = hash_bytes(e->data.items, e->data.count);
+        if (current) {
+            editor_retokenize(e);
+        } else {
+            // Lexed once it is switched to
+            editor_drop_derived(e);
+            b->dropped = true;
+        }
+    }
+
+    if (s->views_count >= 1 && s->views_count <= BUFFERS_VIEWS_CAP && s->focus < s->views_count) {
+        memcpy(b->views, s->views, sizeof(b->views));
+        b->views_count = s->views_count;
+        b->focus = s->focus;
+    }
+    for (size_t i = 0; i < b->views_count; ++i) {
+        View *v = &b->views[i];
+        if (v->cursor > e->data.count) v->cursor = e->data.count;
+        if (v->select_begin > e->data.count) v->select_begin = e->data.count;
+    }
+    const View *focused = &b->views[b->focus];
+    e->cursor = focused->cursor;
+    e->select_begin = focused->select_begin;
+    e->selection = focused->selection;
+
+    b->last_used = ++buffers.clock;
+    if (b != first) da_append(&buffers.list, b);
+    return b;
+}
+
+Errno buffers_restore_session(Simple_Renderer *sr)
+{
+    assert(buffers.list.count == 1 && buffer_pristine(buffers.list.items[0]));
+    TRACE_BEGIN("buffers_restore_session");
+
+    Errno result = 0;
+    String_Builder path = {0};
+    const char *data = NULL;
+    size_t size = 0;
+    size_t current = 0;
+
+    Errno err = session_file_path(&path);
+    if (err != 0) return_defer(err);
+    err = map_entire_file(path.items, &data, &size);
+    if (err != 0) return_defer(err);
+
+    // A session of another version is as good as none
+    const Session_Header *header = (const Session_Header *)data;
+    if (size < sizeof(*header)) return_defer(EINVAL);
+    if (memcmp(header->magic, SESSION_MAGIC, sizeof(header->magic)) != 0 || header->version != SESSION_VERSION) return_defer(0);
+    bool metrics_match = header->metrics_hash == session_metrics_hash();
+
+    size_t at = sizeof(*header);
+    for (uint32_t i = 0; i < header->buffers_count; ++i) {
+        if (size - at < sizeof(Session_Buffer)) return_defer(EINVAL);
+        const Session_Buffer *s = (const Session_Buffer *)(data + at);
+        at += sizeof(*s);
+
+        if (s->path_len == 0 || s->path_len > size - at) return_defer(EINVAL);
+        buffers.path.count = 0;
+        sb_append_buf(&buffers.path, data + at, s->path_len);
+        sb_append_null(&buffers.path);
+        at += SESSION_ALIGN(s->path_len);
+
+        if (at > size || s->lines_count > (size - at) / sizeof(uint64_t)) return_defer(EINVAL);
+        const uint64_t *lines = (const uint64_t *)(data + at);
+        at += s->lines_count * sizeof(uint64_t);
+        if (s->tokens_count > (size - at) / sizeof(Session_Token)) return_defer(EINVAL);
+        const Session_Token *tokens = (const Session_Token *)(data + at);
+        at += s->tokens_count * sizeof(Session_Token);
+
+        // The files that are gone since are left out
+        if (session_restore_buffer(s, buffers.path.items, lines, tokens, metrics_match, i == header->current) != NULL) {
+            if (i == header->current) current = buffers.list.count - 1;
+        }
+    }
+
+defer:
+    if (!buffer_pristine(buffers.list.items[0])) buffers_enter(current, sr);
+    if (data != NULL) unmap_entire_file(data, size);
+    free(path.items);
+    TRACE_END("buffers_restore_session");
+    return result;
+}
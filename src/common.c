@@ -1,3 +1,8 @@
+// d_type, dirfd() and fstatat() are not visible with -std=c11 otherwise
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,39 +11,88 @@
 #ifdef _WIN32
 #define MINIRENT_IMPLEMENTATION
 #include <minirent.h>
+#include <direct.h>
+#include <sys/stat.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #endif // _WIN32
 
 #include "common.h"
+#include "trace.h"
 #define ARENA_IMPLEMENTATION
 #include "arena.h"
 #define SV_IMPLEMENTATION
 #include "sv.h"
 
-static Arena temporary_arena = {0};
+static Arena frame_arena = {0};
+
+void *frame_alloc(size_t size)
+{
+    return arena_alloc(&frame_arena, size);
+}
 
-char *temp_strdup(const char *s)
+char *frame_sprintf(const char *fmt, ...)
 {
-    size_t n = strlen(s);
-    char *ds = arena_alloc(&temporary_arena, n + 1);
-    memcpy(ds, s, n);
-    ds[n] = '\0';
-    return ds;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    assert(n >= 0);
+
+    char *result = frame_alloc((size_t)n + 1);
+    va_start(args, fmt);
+    vsnprintf(result, (size_t)n + 1, fmt, args);
+    va_end(args);
+    return result;
 }
 
-void temp_reset(void)
+void frame_reset(void)
 {
-    arena_reset(&temporary_arena);
+    arena_reset(&frame_arena);
 }
 
-Errno read_entire_dir(const char *dir_path, Files *files)
+const File_Name *file_name_new(Arena *arena, const char *name, size_t len)
+{
+    File_Name *result = arena_alloc(arena, sizeof(File_Name) + len + 1);
+    result->len = (uint32_t)len;
+    memcpy(result->data, name, len);
+    result->data[len] = '\0';
+    return result;
+}
+
+#ifndef _WIN32
+// d_type saves a syscall per entry. Only the file systems that leave it unknown and the
+// symlinks, whose target is what matters, cost an fstatat() relative to the directory.
+static File_Type dir_entry_type(DIR *dir, const struct dirent *ent)
+{
+#ifdef DT_DIR
+    switch (ent->d_type) {
+    case DT_REG: return FT_REGULAR;
+    case DT_DIR: return FT_DIRECTORY;
+    case DT_LNK:
+    case DT_UNKNOWN: break;
+    default: return FT_OTHER;
+    }
+#endif // DT_DIR
+
+    struct stat sb = {0};
+    if (fstatat(dirfd(dir), ent->d_name, &sb, 0) < 0) return FT_OTHER;
+    if (S_ISREG(sb.st_mode)) return FT_REGULAR;
+    if (S_ISDIR(sb.st_mode)) return FT_DIRECTORY;
+    return FT_OTHER;
+}
+#endif // _WIN32
+
+Errno read_entire_dir(const char *dir_path, Files *files, Arena *names)
 {
     Errno result = 0;
     DIR *dir = NULL;
+    TRACE_BEGIN("read_entire_dir");
 
     dir = opendir(dir_path);
     if (dir == NULL)
@@ -50,7 +104,15 @@ Errno read_entire_dir(const char *dir_path, Files *files)
     struct dirent *ent = readdir(dir);
     while (ent != NULL)
     {
-        da_append(files, temp_strdup(ent->d_name));
+        File_Entry entry = {0};
+        entry.name = file_name_new(names, ent->d_name, strlen(ent->d_name));
+#ifdef _WIN32
+        // TODO: type of the directory entries on Windows
+        entry.type = FT_OTHER;
+#else
+        entry.type = dir_entry_type(dir, ent);
+#endif // _WIN32
+        da_append(files, entry);
         ent = readdir(dir);
     }
 
@@ -62,6 +124,7 @@ Errno read_entire_dir(const char *dir_path, Files *files)
 defer:
     if (dir)
         closedir(dir);
+    TRACE_END("read_entire_dir");
     return result;
 }
 
@@ -104,6 +167,7 @@ Errno read_entire_file(const char *file_path, String_Builder *strb)
 {
     Errno result = 0;
     FILE *f = NULL;
+    TRACE_BEGIN("read_entire_file");
 
     f = fopen(file_path, "r");
     if (f == NULL)
@@ -129,9 +193,110 @@ Errno read_entire_file(const char *file_path, String_Builder *strb)
 defer:
     if (f)
         fclose(f);
+    TRACE_END("read_entire_file");
     return result;
 }
 
+Errno map_entire_file(const char *file_path, const char **data, size_t *size)
+{
+#ifdef _WIN32
+    String_Builder sb = {0};
+    Errno err = read_entire_file(file_path, &sb);
+    if (err != 0) {
+        free(sb.items);
+        return err;
+    }
+    *data = sb.items;
+    *size = sb.count;
+    return 0;
+#else
+    Errno result = 0;
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) return_defer(errno);
+
+    struct stat st = {0};
+    if (fstat(fd, &st) < 0) return_defer(errno);
+    if (st.st_size == 0) return_defer(EINVAL);
+
+    void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) return_defer(errno);
+
+    *data = ptr;
+    *size = (size_t)st.st_size;
+
+defer:
+    if (fd >= 0) close(fd);
+    return result;
+#endif // _WIN32
+}
+
+void unmap_entire_file(const char *data, size_t size)
+{
+#ifdef _WIN32
+    UNUSED(size);
+    free((void *)data);
+#else
+    munmap((void *)data, size);
+#endif // _WIN32
+}
+
+static Errno make_dir(const char *dir_path)
+{
+#ifdef _WIN32
+    if (_mkdir(dir_path) < 0 && errno != EEXIST) return errno;
+#else
+    if (mkdir(dir_path, 0755) < 0 && errno != EEXIST) return errno;
+#endif // _WIN32
+    return 0;
+}
+
+Errno cache_file_path(const char *file_name, String_Builder *path)
+{
+    path->count = 0;
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home != NULL && *xdg_cache_home != '\0') {
+        sb_append_cstr(path, xdg_cache_home);
+    }
+    else {
+#ifdef _WIN32
+        const char *home = getenv("LOCALAPPDATA");
+#else
+        const char *home = getenv("HOME");
+#endif // _WIN32
+        if (home == NULL || *home == '\0') return ENOENT;
+        sb_append_cstr(path, home);
+#ifndef _WIN32
+        sb_append_cstr(path, "/.cache");
+        sb_append_null(path);
+        Errno err = make_dir(path->items);
+        if (err != 0) return err;
+        path->count -= 1;
+#endif // _WIN32
+    }
+
+    sb_append_cstr(path, "/detey");
+    sb_append_null(path);
+    Errno err = make_dir(path->items);
+    if (err != 0) return err;
+    path->count -= 1;
+
+    sb_append_cstr(path, "/");
+    sb_append_cstr(path, file_name);
+    sb_append_null(path);
+
+    return 0;
+}
+
+uint64_t hash_bytes(const char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 Vec4f hex_to_vec4f(uint32_t color)
 {
     Vec4f result;
@@ -159,3 +324,18 @@ Errno type_of_file(const char *file_path, File_Type *ftype)
 #endif
     return 0;
 }
+
+Errno stamp_of_file(const char *file_path, File_Stamp *stamp)
+{
+    struct stat sb = {0};
+    if (stat(file_path, &sb) < 0) return errno;
+    stamp->size = (uint64_t)sb.st_size;
+#ifdef _WIN32
+    stamp->mtime_sec = (int64_t)sb.st_mtime;
+    stamp->mtime_nsec = 0;
+#else
+    stamp->mtime_sec = (int64_t)sb.st_mtim.tv_sec;
+    stamp->mtime_nsec = (int64_t)sb.st_mtim.tv_nsec;
+#endif // _WIN32
+    return 0;
+}
@@ -5,6 +5,16 @@
 #include <string.h>
 #include "editor.h"
 #include "common.h"
+#include "profiler.h"
+#include "trace.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif // __linux__
+
+// Past this many inserted and deleted lines a reload is patched in as a single change
+#define EDITOR_DIFF_MAX_EDITS 512
 
 // TODO: make line spacing configurable
 // TODO: 
@@ -83,6 +93,121 @@ void editor_delete_word_right(Editor *e)
 // TODO: make sure that you always have new line at the end of the file while saving
 // https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap03.html#tag_03_206
 
+// Watches the directory rather than the file, since a lot of programs save by writing a new
+// file and renaming it over the old one
+static void editor_watch_file(Editor *e)
+{
+    // Whatever is being read belongs to the previous file
+    if (e->reload.thread != NULL) {
+        SDL_WaitThread(e->reload.thread, NULL);
+        e->reload.thread = NULL;
+    }
+    e->reload.again = false;
+
+#ifdef __linux__
+    if (!e->watching) {
+        e->watching = true;
+        e->watch = -1;
+        e->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (e->watch_fd < 0) fprintf(stderr, "WARNING: Could not watch the files for changes: %s\n", strerror(errno));
+    }
+    if (e->watch_fd < 0) return;
+    if (e->watch >= 0) inotify_rm_watch(e->watch_fd, e->watch);
+
+    const char *file_path = e->file_path.items;
+    const char *slash = strrchr(file_path, '/');
+    const char *dir_path = ".";
+    if (slash == file_path) dir_path = "/";
+    else if (slash != NULL) dir_path = frame_sprintf("%.*s", (int)(slash - file_path), file_path);
+    e->watch_name = slash == NULL ? 0 : (size_t)(slash - file_path) + 1;
+
+    e->watch = inotify_add_watch(e->watch_fd, dir_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (e->watch < 0) fprintf(stderr, "WARNING: Could not watch %s for changes: %s\n", dir_path, strerror(errno));
+#endif // __linux__
+}
+
+static int editor_reload_thread(void *data)
+{
+    Editor_Reload *reload = data;
+    reload->contents.count = 0;
+    reload->err = read_entire_file(reload->file_path.items, &reload->contents);
+    SDL_AtomicSet(&reload->done, 1);
+    return 0;
+}
+
+static void editor_start_reload(Editor *e)
+{
+    Editor_Reload *reload = &e->reload;
+    reload->file_path.count = 0;
+    sb_append_buf(&reload->file_path, e->file_path.items, e->file_path.count);
+    SDL_AtomicSet(&reload->done, 0);
+    reload->thread = SDL_CreateThread(editor_reload_thread, "editor_reload", reload);
+    if (reload->thread == NULL) {
+        fprintf(stderr, "WARNING: Could not reload %s: %s\n", e->file_path.items, SDL_GetError());
+    }
+}
+
+static void editor_finish_reload(Editor *e)
+{
+    Editor_Reload *reload = &e->reload;
+    SDL_WaitThread(reload->thread, NULL);
+    reload->thread = NULL;
+    if (reload->err != 0) {
+        // Probably removed in between the writes, the next one is going to bring it back
+        if (reload->err != ENOENT) fprintf(stderr, "ERROR: Could not reload %s: %s\n", e->file_path.items, strerror(reload->err));
+        return;
+    }
+
+    // Our own save or a write of the same contents
+    uint64_t hash = hash_bytes(reload->contents.items, reload->contents.count);
+    if (hash == e->file_hash) return;
+
+    if (hash_bytes(e->data.items, e->data.count) != e->file_hash) {
+        fprintf(stderr, "WARNING: %s changed on disk while it has unsaved changes, saving is going to overwrite them\n", e->file_path.items);
+        return;
+    }
+
+    printf("Reloading %s\n", e->file_path.items);
+    editor_patch(e, &reload->contents);
+    e->file_hash = hash;
+}
+
+void editor_poll_changes(Editor *e)
+{
+#ifdef __linux__
+    if (!e->watching || e->watch < 0) return;
+
+    const char *name = e->file_path.items + e->watch_name;
+    bool changed = false;
+    _Alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t n = read(e->watch_fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+
+        for (char *p = buffer; p < buffer + n;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(*event) + event->len;
+            if (event->wd == e->watch && event->len > 0 && strcmp(event->name, name) == 0) changed = true;
+        }
+    }
+
+    if (changed) {
+        if (e->reload.thread != NULL) e->reload.again = true;
+        else editor_start_reload(e);
+    }
+
+    if (e->reload.thread != NULL && SDL_AtomicGet(&e->reload.done)) {
+        editor_finish_reload(e);
+        if (e->reload.again) {
+            e->reload.again = false;
+            editor_start_reload(e);
+        }
+    }
+#else
+    UNUSED(e);
+#endif // __linux__
+}
+
 Errno editor_save_as(Editor *e, const char *file_path)
 {
     printf("Saving as %s...\n", file_path);
@@ -91,17 +216,22 @@ Errno editor_save_as(Editor *e, const char *file_path)
     e->file_path.count = 0;
     sb_append_cstr(&e->file_path, file_path);
     sb_append_null(&e->file_path);
+    e->file_hash = hash_bytes(e->data.items, e->data.count);
+    editor_watch_file(e);
     return 0;
 }
 
-Errno editor_save(const Editor *e)
+Errno editor_save(Editor *e)
 {
     assert(e->file_path.count > 0);
     printf("Saving as %s...\n", e->file_path.items);
-    return write_entire_file(e->file_path.items, e->data.items, e->data.count);
+    Errno err = write_entire_file(e->file_path.items, e->data.items, e->data.count);
+    if (err != 0) return err;
+    e->file_hash = hash_bytes(e->data.items, e->data.count);
+    return 0;
 }
 
-Errno editor_load_from_file(Editor *e, const char *file_path)
+Errno editor_load_text_from_file(Editor *e, const char *file_path)
 {
     printf("Loading %s\n", file_path);
 
@@ -111,15 +241,59 @@ Errno editor_load_from_file(Editor *e, const char *file_path)
 
     e->cursor = 0;
 
-    editor_retokenize(e);
-
     e->file_path.count = 0;
     sb_append_cstr(&e->file_path, file_path);
     sb_append_null(&e->file_path);
+    editor_watch_file(e);
+
+    return 0;
+}
 
+Errno editor_load_from_file(Editor *e, const char *file_path)
+{
+    Errno err = editor_load_text_from_file(e, file_path);
+    if (err != 0) return err;
+
+    editor_retokenize(e);
+    e->file_hash = hash_bytes(e->data.items, e->data.count);
     return 0;
 }
 
+void editor_free(Editor *e)
+{
+    if (e->reload.thread != NULL) SDL_WaitThread(e->reload.thread, NULL);
+#ifdef __linux__
+    if (e->watching && e->watch_fd >= 0) close(e->watch_fd);
+#endif // __linux__
+    free(e->data.items);
+    free(e->lines.items);
+    free(e->tokens.items);
+    free(e->layout.items);
+    free(e->file_path.items);
+    free(e->search.items);
+    free(e->clipboard.items);
+    free(e->reload.file_path.items);
+    free(e->reload.contents.items);
+    memset(e, 0, sizeof(*e));
+}
+
+size_t editor_derived_size(const Editor *e)
+{
+    return e->lines.capacity * sizeof(*e->lines.items)
+        + e->tokens.capacity * sizeof(*e->tokens.items)
+        + e->layout.capacity * sizeof(*e->layout.items);
+}
+
+void editor_drop_derived(Editor *e)
+{
+    free(e->lines.items);
+    free(e->tokens.items);
+    free(e->layout.items);
+    memset(&e->lines, 0, sizeof(e->lines));
+    memset(&e->tokens, 0, sizeof(e->tokens));
+    memset(&e->layout, 0, sizeof(e->layout));
+}
+
 size_t editor_cursor_row(const Editor *e)
 {
     assert(e->lines.count > 0);
@@ -139,10 +313,8 @@ void editor_move_line_up(Editor *e)
     size_t cursor_row = editor_cursor_row(e);
     size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
     if (cursor_row > 0) {
-        Line next_line = e->lines.items[cursor_row - 1];
-        size_t next_line_size = next_line.end - next_line.begin;
-        if (cursor_col > next_line_size) cursor_col = next_line_size;
-        e->cursor = next_line.begin + cursor_col;
+        float x = editor_line_x(e, cursor_row, cursor_col);
+        e->cursor = e->lines.items[cursor_row - 1].begin + editor_line_col(e, cursor_row - 1, x);
     }
 }
 
@@ -153,10 +325,8 @@ void editor_move_line_down(Editor *e)
     size_t cursor_row = editor_cursor_row(e);
     size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
     if (cursor_row < e->lines.count - 1) {
-        Line next_line = e->lines.items[cursor_row + 1];
-        size_t next_line_size = next_line.end - next_line.begin;
-        if (cursor_col > next_line_size) cursor_col = next_line_size;
-        e->cursor = next_line.begin + cursor_col;
+        float x = editor_line_x(e, cursor_row, cursor_col);
+        e->cursor = e->lines.items[cursor_row + 1].begin + editor_line_col(e, cursor_row + 1, x);
     }
 }
 
@@ -255,12 +425,17 @@ void editor_insert_buf(Editor *e, char *buf, size_t buf_len)
 
 void editor_retokenize(Editor *e)
 {
+    profiler_begin(PROFILER_STAGE_RETOKENIZE);
+    TRACE_BEGIN("editor_retokenize");
+
     // Lines
     {
         e->lines.count = 0;
+        e->layout.count = 0;
 
         Line line;
         line.begin = 0;
+        line.layout = LINE_NO_LAYOUT;
 
         for (size_t i = 0; i < e->data.count; ++i) {
             if (e->data.items[i] == '\n') {
@@ -276,6 +451,7 @@ void editor_retokenize(Editor *e)
 
     // Syntax Highlighting
     {
+        TRACE_BEGIN("lexer_next loop");
         e->tokens.count = 0;
         Lexer l = lexer_new(e->atlas, e->data.items, e->data.count);
         Token t = lexer_next(&l);
@@ -283,7 +459,339 @@ void editor_retokenize(Editor *e)
             da_append(&e->tokens, t);
             t = lexer_next(&l);
         }
+        TRACE_END("lexer_next loop");
     }
+
+    TRACE_END("editor_retokenize");
+    profiler_end(PROFILER_STAGE_RETOKENIZE);
+}
+
+// A run of lines that differ between the old and the new contents, [begin, end) in lines and
+// [from, to) in bytes. The bytes start at the newline before the first line, which tokens
+// such as comments end with.
+typedef struct
+{
+    size_t old_begin, old_end;
+    size_t new_begin, new_end;
+    size_t old_from, old_to;
+    size_t new_from, new_to;
+} Hunk;
+
+// All of the diffing happens in the frame arena, only the new lines and tokens outlive it
+typedef struct
+{
+    Hunk *items;
+    size_t count;
+    size_t capacity;
+} Hunks;
+
+typedef struct
+{
+    const char *old_data;
+    const Lines *old_lines;
+    const uint64_t *old_hashes;
+    const char *new_data;
+    const Lines *new_lines;
+    const uint64_t *new_hashes;
+} Diff;
+
+static void split_lines(const char *data, size_t size, Lines *lines)
+{
+    lines->count = 0;
+    Line line = {.begin = 0, .layout = LINE_NO_LAYOUT};
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n') {
+            line.end = i;
+            da_append(lines, line);
+            line.begin = i + 1;
+        }
+    }
+    line.end = size;
+    da_append(lines, line);
+}
+
+static const uint64_t *hash_lines(const char *data, const Lines *lines)
+{
+    uint64_t *hashes = frame_alloc(lines->count * sizeof(*hashes));
+    for (size_t i = 0; i < lines->count; ++i) {
+        Line line = lines->items[i];
+        hashes[i] = hash_bytes(data + line.begin, line.end - line.begin);
+    }
+    return hashes;
+}
+
+static bool diff_lines_equal(const Diff *d, size_t old_row, size_t new_row)
+{
+    if (d->old_hashes[old_row] != d->new_hashes[new_row]) return false;
+    Line a = d->old_lines->items[old_row];
+    Line b = d->new_lines->items[new_row];
+    return a.end - a.begin == b.end - b.begin && memcmp(d->old_data + a.begin, d->new_data + b.begin, a.end - a.begin) == 0;
+}
+
+static void diff_hunk(const Diff *d, Hunks *hunks, size_t old_begin, size_t old_end, size_t new_begin, size_t new_end)
+{
+    if (old_begin == old_end && new_begin == new_end) return;
+
+    const Lines *a = d->old_lines;
+    const Lines *b = d->new_lines;
+    Hunk hunk = {old_begin, old_end, new_begin, new_end, 0, 0, 0, 0};
+    hunk.old_from = old_begin > 0 ? a->items[old_begin - 1].end : 0;
+    hunk.new_from = new_begin > 0 ? b->items[new_begin - 1].end : 0;
+    hunk.old_to = old_end < a->count ? a->items[old_end].begin : a->items[a->count - 1].end;
+    hunk.new_to = new_end < b->count ? b->items[new_end].begin : b->items[b->count - 1].end;
+    assert(hunks->count < hunks->capacity);
+    hunks->items[hunks->count++] = hunk;
+}
+
+// Myers' O(ND) diff of the lines in between the common prefix and suffix
+static void diff_lines(const Diff *d, Hunks *hunks)
+{
+    const size_t n = d->old_lines->count;
+    const size_t m = d->new_lines->count;
+
+    size_t prefix = 0;
+    while (prefix < n && prefix < m && diff_lines_equal(d, prefix, prefix)) prefix += 1;
+    size_t suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix && diff_lines_equal(d, n - 1 - suffix, m - 1 - suffix)) suffix += 1;
+
+    const size_t a0 = prefix;
+    const size_t b0 = prefix;
+    const long N = (long)(n - suffix - a0);
+    const long M = (long)(m - suffix - b0);
+    if (N == 0 || M == 0) {
+        diff_hunk(d, hunks, a0, a0 + N, b0, b0 + M);
+        return;
+    }
+
+    long max = N + M;
+    if (max > EDITOR_DIFF_MAX_EDITS) max = EDITOR_DIFF_MAX_EDITS;
+    const long off = max + 1;
+    long *v = frame_alloc((2 * max + 3) * sizeof(long));
+    memset(v, 0, (2 * max + 3) * sizeof(long));
+    // The diagonals before every step d, d*d values for all of the steps before it
+    long *trace = frame_alloc((max + 1) * (max + 1) * sizeof(long));
+
+    long edits = -1;
+    for (long d_ = 0; d_ <= max && edits < 0; ++d_) {
+        memcpy(trace + d_ * d_, v + off - d_, (2 * d_ + 1) * sizeof(long));
+        for (long k = -d_; k <= d_; k += 2) {
+            long x;
+            if (k == -d_ || (k != d_ && v[off + k - 1] < v[off + k + 1])) x = v[off + k + 1];
+            else x = v[off + k - 1] + 1;
+            long y = x - k;
+            while (x < N && y < M && diff_lines_equal(d, a0 + x, b0 + y)) {
+                x += 1;
+                y += 1;
+            }
+            v[off + k] = x;
+            if (x >= N && y >= M) {
+                edits = d_;
+                break;
+            }
+        }
+    }
+
+    if (edits < 0) {
+        diff_hunk(d, hunks, a0, a0 + N, b0, b0 + M);
+    } else {
+        // Walking back from the end, every diagonal step is a pair of equal lines
+        size_t *pairs = frame_alloc(2 * (N < M ? N : M) * sizeof(*pairs));
+        size_t pairs_count = 0;
+        long x = N;
+        long y = M;
+        for (long d_ = edits; d_ >= 0; --d_) {
+            long prev_x = 0;
+            long prev_y = 0;
+            if (d_ > 0) {
+                const long *vd = trace + d_ * d_ + d_;
+                long k = x - y;
+                long prev_k = (k == -d_ || (k != d_ && vd[k - 1] < vd[k + 1])) ? k + 1 : k - 1;
+                prev_x = vd[prev_k];
+                prev_y = prev_x - prev_k;
+            }
+            while (x > prev_x && y > prev_y) {
+                x -= 1;
+                y -= 1;
+                pairs[pairs_count++] = (size_t)x;
+                pairs[pairs_count++] = (size_t)y;
+            }
+            x = prev_x;
+            y = prev_y;
+        }
+
+        size_t old_row = a0;
+        size_t new_row = b0;
+        for (size_t i = pairs_count; i > 0; i -= 2) {
+            size_t old_equal = a0 + pairs[i - 2];
+            size_t new_equal = b0 + pairs[i - 1];
+            diff_hunk(d, hunks, old_row, old_equal, new_row, new_equal);
+            old_row = old_equal + 1;
+            new_row = new_equal + 1;
+        }
+        diff_hunk(d, hunks, old_row, a0 + N, new_row, b0 + M);
+    }
+}
+
+static size_t token_line(Token t)
+{
+    return (size_t)(-t.position.y / (FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR) + 0.5f);
+}
+
+static Token token_moved(Token t, const char *old_data, const char *new_data, size_t delta_bytes, size_t delta_lines)
+{
+    // The deltas wrap around when things move back, which unsigned arithmetic is fine with
+    t.text = new_data + ((size_t)(t.text - old_data) + delta_bytes);
+    t.position.y = -(float)(token_line(t) + delta_lines) * FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR;
+    return t;
+}
+
+// Where a position of the old contents ends up, one inside of a hunk keeps its distance from the
+// start of the hunk if it can
+static size_t hunks_move(const Hunks *hunks, size_t pos)
+{
+    size_t delta = 0;
+    for (size_t i = 0; i < hunks->count; ++i) {
+        const Hunk *h = &hunks->items[i];
+        if (pos < h->old_from) break;
+        if (pos < h->old_to) {
+            size_t offset = pos - h->old_from;
+            return h->new_from + (offset < h->new_to - h->new_from ? offset : h->new_to - h->new_from);
+        }
+        delta = h->new_to - h->old_to;
+    }
+    return pos + delta;
+}
+
+// The x advances of the lines that changed stay behind in e->layout. A file that keeps being
+// reloaded never goes through editor_retokenize(), so once they outweigh the ones of the live
+// lines, those are copied over into a fresh array.
+static void editor_compact_layout(Editor *e)
+{
+    size_t live = 0;
+    for (size_t row = 0; row < e->lines.count; ++row) {
+        const Line *line = &e->lines.items[row];
+        if (line->layout != LINE_NO_LAYOUT) live += line->end - line->begin + 1;
+    }
+    if (e->layout.count - live <= live) return;
+
+    Layout layout = {0};
+    if (live > 0) {
+        layout.capacity = live;
+        layout.items = malloc(layout.capacity * sizeof(*layout.items));
+        assert(layout.items != NULL && "Buy more RAM lol");
+    }
+    for (size_t row = 0; row < e->lines.count; ++row) {
+        Line *line = &e->lines.items[row];
+        if (line->layout == LINE_NO_LAYOUT) continue;
+        size_t n = line->end - line->begin + 1;
+        memcpy(layout.items + layout.count, e->layout.items + line->layout, n * sizeof(*layout.items));
+        line->layout = layout.count;
+        layout.count += n;
+    }
+    free(e->layout.items);
+    e->layout = layout;
+}
+
+void editor_patch(Editor *e, String_Builder *contents)
+{
+    profiler_begin(PROFILER_STAGE_RETOKENIZE);
+    TRACE_BEGIN("editor_patch");
+
+    Lines new_lines = {0};
+    split_lines(contents->items, contents->count, &new_lines);
+
+    Diff d = {0};
+    d.old_data = e->data.items;
+    d.old_lines = &e->lines;
+    d.new_data = contents->items;
+    d.new_lines = &new_lines;
+    d.old_hashes = hash_lines(d.old_data, d.old_lines);
+    d.new_hashes = hash_lines(d.new_data, d.new_lines);
+
+    // The hunks are separated by equal lines
+    Hunks hunks = {0};
+    hunks.capacity = (e->lines.count < new_lines.count ? e->lines.count : new_lines.count) + 1;
+    hunks.items = frame_alloc(hunks.capacity * sizeof(*hunks.items));
+    diff_lines(&d, &hunks);
+
+    // The lines in between the hunks keep their x advances
+    {
+        size_t old_row = 0;
+        size_t new_row = 0;
+        for (size_t i = 0; i <= hunks.count; ++i) {
+            size_t new_end = i < hunks.count ? hunks.items[i].new_begin : new_lines.count;
+            while (new_row < new_end) new_lines.items[new_row++].layout = e->lines.items[old_row++].layout;
+            if (i < hunks.count) {
+                old_row = hunks.items[i].old_end;
+                new_row = hunks.items[i].new_end;
+            }
+        }
+    }
+
+    // The tokens in between the hunks are moved over, the lexer only goes through the hunks and
+    // stops as soon as it starts a token where an old one starts
+    Tokens tokens = {0};
+    {
+        const Tokens *old = &e->tokens;
+        size_t old_i = 0;
+        size_t delta_bytes = 0;
+        size_t delta_lines = 0;
+        bool lexed_to_end = false;
+        for (size_t h = 0; h < hunks.count && !lexed_to_end; ++h) {
+            const Hunk *hunk = &hunks.items[h];
+            while (old_i < old->count && (size_t)(old->items[old_i].text - d.old_data) + old->items[old_i].text_len <= hunk->old_from) {
+                da_append(&tokens, token_moved(old->items[old_i++], d.old_data, d.new_data, delta_bytes, delta_lines));
+            }
+
+            Lexer l = lexer_new(e->atlas, contents->items, contents->count);
+            if (old_i < old->count && (size_t)(old->items[old_i].text - d.old_data) < hunk->old_from) {
+                // A token that runs into the hunk
+                Token t = token_moved(old->items[old_i], d.old_data, d.new_data, delta_bytes, delta_lines);
+                l.cursor = (size_t)(t.text - d.new_data);
+                l.line = token_line(t);
+                l.x = t.position.x;
+            } else {
+                l.cursor = hunk->new_from;
+                l.line = hunk->new_begin > 0 ? hunk->new_begin - 1 : 0;
+            }
+            l.bol = new_lines.items[l.line].begin;
+
+            for (;;) {
+                Token t = lexer_next(&l);
+                if (t.kind == TOKEN_END) {
+                    lexed_to_end = true;
+                    break;
+                }
+
+                size_t pos = (size_t)(t.text - d.new_data);
+                while (h + 1 < hunks.count && pos >= hunks.items[h + 1].new_from) h += 1;
+                hunk = &hunks.items[h];
+                delta_bytes = hunk->new_to - hunk->old_to;
+                delta_lines = hunk->new_end - hunk->old_end;
+
+                if (pos >= hunk->new_to) {
+                    while (old_i < old->count && (size_t)(old->items[old_i].text - d.old_data) + delta_bytes < pos) old_i += 1;
+                    if (old_i < old->count && (size_t)(old->items[old_i].text - d.old_data) + delta_bytes == pos) break;
+                }
+                da_append(&tokens, t);
+            }
+        }
+
+        while (!lexed_to_end && old_i < old->count) {
+            da_append(&tokens, token_moved(old->items[old_i++], d.old_data, d.new_data, delta_bytes, delta_lines));
+        }
+    }
+
+    e->cursor = hunks_move(&hunks, e->cursor);
+    e->select_begin = hunks_move(&hunks, e->select_begin);
+
+    SWAP(String_Builder, e->data, *contents);
+    da_move(&e->lines, new_lines);
+    da_move(&e->tokens, tokens);
+    editor_compact_layout(e);
+
+    TRACE_END("editor_patch");
+    profiler_end(PROFILER_STAGE_RETOKENIZE);
 }
 
 bool editor_line_starts_with(Editor *e, size_t row, size_t col, const char *prefix)
@@ -314,21 +822,52 @@ const char *editor_line_starts_with_one_of(Editor *e, size_t row, size_t col, co
     return NULL;
 }
 
-void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr, Editor *editor)
+// The first token on the row or past it. The tokens are in the order of the text, so in the order
+// of their rows too. A token is drawn on the row it starts on, even the ones that run past it.
+static size_t editor_first_token_at(const Editor *e, size_t row)
+{
+    size_t lo = 0;
+    size_t hi = e->tokens.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (token_line(e->tokens.items[mid]) < row) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void editor_render(Free_Glyph_Atlas *atlas, Simple_Renderer *sr, Editor *editor)
 {
-    int w, h;
-    SDL_GetWindowSize(window, &w, &h);
+    // The resolution is kept up to date by whoever owns the framebuffer
+    int w = (int)sr->resolution.x;
 
+    // The widest of the lines on the screen
     float max_line_len = 0.0f;
 
-    sr->resolution = vec2f(w, h);
     sr->time = (float)SDL_GetTicks() / 1000.0f;
 
+    TRACE_BEGIN("editor_render");
+
+    // Only the rows on the screen, with one more on either side for the glyphs that stick out.
+    // Every view of a buffer goes through here, so a view costs what it shows, not the whole file.
+    size_t first_row = 0;
+    size_t last_row = 0;
+    {
+        const float line_height = FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR;
+        float half_height = sr->resolution.y * 0.5f / sr->camera_scale;
+        float top = -(sr->camera_pos.y + half_height) / line_height - 1.0f;
+        float bottom = -(sr->camera_pos.y - half_height) / line_height + 2.0f;
+        if (top > 0.0f) first_row = (size_t)top;
+        if (bottom > 0.0f) last_row = (size_t)bottom;
+        if (last_row > editor->lines.count) last_row = editor->lines.count;
+    }
+
     // Render selection
     {
+        TRACE_BEGIN("selection");
         simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
         if (editor->selection) {
-            for (size_t row = 0; row < editor->lines.count; ++row) {
+            for (size_t row = first_row; row < last_row; ++row) {
                 size_t select_begin_chr = editor->select_begin;
                 size_t select_end_chr = editor->cursor;
                 if (select_begin_chr > select_end_chr) {
@@ -347,21 +886,17 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
 
                 if (select_begin_chr <= select_end_chr) {
                     Vec2f select_begin_scr = vec2f(0, -((float)row + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR);
-                    free_glyph_atlas_measure_line_sized(
-                        atlas, editor->data.items + line_chr.begin, select_begin_chr - line_chr.begin,
-                        &select_begin_scr);
+                    select_begin_scr.x = editor_line_x(editor, row, select_begin_chr - line_chr.begin);
 
                     Vec2f select_end_scr = select_begin_scr;
-                    free_glyph_atlas_measure_line_sized(
-                        atlas, editor->data.items + select_begin_chr, select_end_chr - select_begin_chr,
-                        &select_end_scr);
+                    select_end_scr.x = editor_line_x(editor, row, select_end_chr - line_chr.begin);
 
                     Vec4f selection_color = hex_to_vec4f(0x363a4fff);
                     simple_renderer_solid_rect(sr, select_begin_scr, vec2f(select_end_scr.x - select_begin_scr.x, FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR), selection_color);
                 }
             }
         }
-        simple_renderer_flush(sr);
+        TRACE_END("selection");
     }
 
     Vec2f cursor_pos = vec2fs(0.0f);
@@ -370,11 +905,12 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
         Line line = editor->lines.items[cursor_row];
         size_t cursor_col = editor->cursor - line.begin;
         cursor_pos.y = -((float)cursor_row + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR;
-        cursor_pos.x = free_glyph_atlas_cursor_pos(atlas, editor->data.items + line.begin, line.end - line.begin, vec2f(0.0, cursor_pos.y), cursor_col);
+        cursor_pos.x = editor_line_x(editor, cursor_row, cursor_col);
     }
 
     // Render search
     {
+        TRACE_BEGIN("search");
         if (editor->searching) {
             simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
             Vec4f selection_color = vec4f(.10, .10, .25, 1);
@@ -382,15 +918,17 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
             Vec2f p2 = p1;
             free_glyph_atlas_measure_line_sized(editor->atlas, editor->search.items, editor->search.count, &p2);
             simple_renderer_solid_rect(sr, p1, vec2f(p2.x - p1.x, FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR), selection_color);
-            simple_renderer_flush(sr);
         }
+        TRACE_END("search");
     }
 
     // Render text
     {
+        TRACE_BEGIN("text");
         simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
-        for (size_t i = 0; i < editor->tokens.count; ++i) {
+        for (size_t i = editor_first_token_at(editor, first_row); i < editor->tokens.count; ++i) {
             Token token = editor->tokens.items[i];
+            if (token_line(token) >= last_row) break;
             Vec2f pos = token.position;
             Vec4f color = vec4fs(1);
             switch (token.kind) {
@@ -431,7 +969,7 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
             
             if (max_line_len < pos.x) max_line_len = pos.x;
         }
-        simple_renderer_flush(sr);
+        TRACE_END("text");
     }
 
     // Render cursor
@@ -442,16 +980,17 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
         Uint32 CURSOR_BLINK_PERIOD = 1000;
         Uint32 t = SDL_GetTicks() - editor->last_stroke;
 
-        sr->verticies_count = 0;
         if (t < CURSOR_BLINK_THRESHOLD || t / CURSOR_BLINK_PERIOD % 2 != 0) {
             simple_renderer_solid_rect(sr, cursor_pos, vec2f(CURSOR_WIDTH, FREE_GLYPH_FONT_SIZE * LINE_SPACING_FACTOR), vec4fs(1));
         }
-
-        simple_renderer_flush(sr);
     }
 
+    // Everything above goes out in a single draw call, in the order it was added
+    simple_renderer_flush(sr);
+
     // Update camera
     {
+        TRACE_BEGIN("camera");
         if (max_line_len > 1000.0f) {
             max_line_len = 1000.0f;
         }
@@ -475,9 +1014,12 @@ void editor_render(SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer
             vec2fs(2.0f));
         sr->camera_scale_vel = (target_scale - sr->camera_scale) * 2.0f;
 
-        sr->camera_pos = vec2f_add(sr->camera_pos, vec2f_mul(sr->camera_vel, vec2fs(DELTA_TIME)));
-        sr->camera_scale = sr->camera_scale + sr->camera_scale_vel * DELTA_TIME;
+        sr->camera_pos = vec2f_add(sr->camera_pos, vec2f_mul(sr->camera_vel, vec2fs(sr->delta_time)));
+        sr->camera_scale = sr->camera_scale + sr->camera_scale_vel * sr->delta_time;
+        TRACE_END("camera");
     }
+
+    TRACE_END("editor_render");
 }
 
 void editor_update_selection(Editor *e, bool shift)
@@ -561,6 +1103,46 @@ bool editor_search_matches_at(Editor *e, size_t pos)
     return true;
 }
 
+static const float *editor_line_layout(Editor *e, size_t row)
+{
+    assert(row < e->lines.count);
+    Line *line = &e->lines.items[row];
+    if (line->layout == LINE_NO_LAYOUT) {
+        line->layout = e->layout.count;
+        Vec2f pos = vec2fs(0.0f);
+        da_append(&e->layout, pos.x);
+        for (size_t i = line->begin; i < line->end; ++i) {
+            free_glyph_atlas_measure_line_sized(e->atlas, &e->data.items[i], 1, &pos);
+            da_append(&e->layout, pos.x);
+        }
+    }
+    return &e->layout.items[line->layout];
+}
+
+float editor_line_x(Editor *e, size_t row, size_t col)
+{
+    Line line = e->lines.items[row];
+    if (col > line.end - line.begin) col = line.end - line.begin;
+    return editor_line_layout(e, row)[col];
+}
+
+size_t editor_line_col(Editor *e, size_t row, float x)
+{
+    const float *xs = editor_line_layout(e, row);
+    size_t count = e->lines.items[row].end - e->lines.items[row].begin + 1;
+
+    // The first column at or past x, the advances never go backwards
+    size_t lo = 0;
+    size_t hi = count - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (xs[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0 && x - xs[lo - 1] < xs[lo] - x) lo -= 1;
+    return lo;
+}
+
 void editor_move_to_begin(Editor *e)
 {
     editor_stop_search(e);
@@ -1,28 +1,120 @@
+#include <errno.h>
 #include <string.h>
 #include "file_browser.h"
 #include "sv.h"
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif // __linux__
+
 static int file_cmp(const void *ap, const void *bp)
 {
-    const char *a = *(const char **)ap;
-    const char *b = *(const char **)bp;
-    return strcmp(a, b);
+    const File_Entry *a = ap;
+    const File_Entry *b = bp;
+    return strcmp(a->name->data, b->name->data);
+}
+
+static void fb_find_longest(File_Browser *fb)
+{
+    fb->longest = 0;
+    for (size_t i = 1; i < fb->files.count; ++i) {
+        if (fb->files.items[i].name->len > fb->files.items[fb->longest].name->len) fb->longest = i;
+    }
+}
+
+static void fb_sort_files(File_Browser *fb)
+{
+    qsort(fb->files.items, fb->files.count, sizeof(*fb->files.items), file_cmp);
+    fb_find_longest(fb);
+}
+
+// What a name takes up in the arena, rounded up like arena_alloc() does
+static size_t file_name_size(const File_Name *name)
+{
+    size_t size = sizeof(File_Name) + name->len + 1;
+    return (size + sizeof(uintptr_t) - 1) / sizeof(uintptr_t) * sizeof(uintptr_t);
+}
+
+// The directory was just read into names, everything in there is live
+static void fb_count_names(File_Browser *fb)
+{
+    fb->names_live = 0;
+    for (size_t i = 0; i < fb->files.count; ++i) {
+        fb->names_live += file_name_size(fb->files.items[i].name);
+    }
+    fb->names_size = fb->names_live;
+}
+
+// Names of the deleted entries stay in the arena until the directory is read again. In a
+// directory that keeps churning files that is never, so once they outweigh the live ones the
+// live ones move over to the spare arena and the old one is reset.
+static void fb_compact_names(File_Browser *fb)
+{
+    if (fb->names_size - fb->names_live <= fb->names_live) return;
+
+    arena_reset(&fb->spare_names);
+    for (size_t i = 0; i < fb->files.count; ++i) {
+        const File_Name *name = fb->files.items[i].name;
+        fb->files.items[i].name = file_name_new(&fb->spare_names, name->data, name->len);
+    }
+    SWAP(Arena, fb->names, fb->spare_names);
+    arena_reset(&fb->spare_names);
+    fb->names_size = fb->names_live;
+}
+
+// Where name is or would be in the sorted listing
+static size_t fb_lower_bound(const File_Browser *fb, const char *name)
+{
+    size_t lo = 0;
+    size_t hi = fb->files.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(fb->files.items[mid].name->data, name) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Moves the watch over to dir_path. Events of the previous directory that are still queued
+// are told apart by the watch descriptor.
+static void fb_watch_dir(File_Browser *fb)
+{
+#ifdef __linux__
+    if (!fb->watching) {
+        fb->watching = true;
+        fb->watch = -1;
+        fb->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fb->watch_fd < 0) fprintf(stderr, "WARNING: Could not watch the directories for changes: %s\n", strerror(errno));
+    }
+    if (fb->watch_fd < 0) return;
+
+    if (fb->watch >= 0) inotify_rm_watch(fb->watch_fd, fb->watch);
+    fb->changes.count = 0;
+    fb->watch = inotify_add_watch(fb->watch_fd, fb->dir_path.items, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (fb->watch < 0) fprintf(stderr, "WARNING: Could not watch %s for changes: %s\n", fb->dir_path.items, strerror(errno));
+#else
+    UNUSED(fb);
+#endif // __linux__
 }
 
 Errno fb_open_dir(File_Browser *fb, const char *dir_path)
 {
     fb->files.count = 0;
     fb->cursor = 0;
-    Errno err = read_entire_dir(dir_path, &fb->files);
+    arena_reset(&fb->names);
+    Errno err = read_entire_dir(dir_path, &fb->files, &fb->names);
     if (err != 0)
     {
         return err;
     }
-    qsort(fb->files.items, fb->files.count, sizeof(*fb->files.items), file_cmp);
+    fb_sort_files(fb);
+    fb_count_names(fb);
 
     fb->dir_path.count = 0;
     sb_append_cstr(&fb->dir_path, dir_path);
     sb_append_null(&fb->dir_path);
+    fb_watch_dir(fb);
 
     return 0;
 }
@@ -38,6 +130,12 @@ typedef struct {
     size_t capacity;
 } Comps;
 
+static void comps_push(Comps *comps, String_View comp)
+{
+    assert(comps->count < comps->capacity);
+    comps->items[comps->count++] = comp;
+}
+
 void normpath(String_View path, String_Builder *result)
 {
     size_t original_sb_size = result->count;
@@ -56,7 +154,10 @@ void normpath(String_View path, String_Builder *result)
         initial_slashes = 1;
     }
 
+    // Every component takes up at least a character and a separator
     Comps new_comps = {0};
+    new_comps.capacity = path.count / 2 + 1;
+    new_comps.items = frame_alloc(new_comps.capacity * sizeof(*new_comps.items));
 
     while (path.count > 0) {
         String_View comp = sv_chop_by_delim(&path, '/');
@@ -64,15 +165,15 @@ void normpath(String_View path, String_Builder *result)
             continue;
         }
         if (!sv_eq(comp, SV(PATH_DOTDOT))) {
-            da_append(&new_comps, comp);
+            comps_push(&new_comps, comp);
             continue;
         }
         if (initial_slashes == 0 && new_comps.count == 0) {
-            da_append(&new_comps, comp);
+            comps_push(&new_comps, comp);
             continue;
         }
         if (new_comps.count > 0 && sv_eq(da_last(&new_comps), SV(PATH_DOTDOT))) {
-            da_append(&new_comps, comp);
+            comps_push(&new_comps, comp);
             continue;
         }
         if (new_comps.count > 0) {
@@ -94,8 +195,6 @@ void normpath(String_View path, String_Builder *result)
     if (original_sb_size == result->count) {
         sb_append_cstr(result, PATH_DOT);
     }
-
-    free(new_comps.items);
 }
 
 Errno fb_change_dir(File_Browser *fb)
@@ -106,63 +205,222 @@ Errno fb_change_dir(File_Browser *fb)
     if (fb->cursor >= fb->files.count)
         return 0;
 
-    const char *dir_name = fb->files.items[fb->cursor];
-
-    fb->dir_path.count -= 1;
+    const char *dir_name = fb->files.items[fb->cursor].name->data;
 
     // TODO: fb->dir_path grows indefinitely if we hit the root
-    sb_append_cstr(&fb->dir_path, "/");
-    sb_append_cstr(&fb->dir_path, dir_name);
-
-    String_Builder result = {0};
-    normpath(sb_to_sv(fb->dir_path), &result);
-    da_move(&fb->dir_path, result);
+    const char *dir_path = frame_sprintf("%s/%s", fb->dir_path.items, dir_name);
+    fb->dir_path.count = 0;
+    normpath(sv_from_cstr(dir_path), &fb->dir_path);
     sb_append_null(&fb->dir_path);
 
     printf("Changed dir to %s\n", fb->dir_path.items);
 
     fb->files.count = 0;
     fb->cursor = 0;
-    Errno err = read_entire_dir(fb->dir_path.items, &fb->files);
+    arena_reset(&fb->names);
+    Errno err = read_entire_dir(fb->dir_path.items, &fb->files, &fb->names);
 
     if (err != 0) {
         return err;
     }
-    qsort(fb->files.items, fb->files.count, sizeof(*fb->files.items), file_cmp);
+    fb_sort_files(fb);
+    fb_count_names(fb);
+    fb_watch_dir(fb);
 
     return 0;
 }
 
-void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
+static int change_cmp(const void *ap, const void *bp)
+{
+    const File_Change *a = ap;
+    const File_Change *b = bp;
+    int cmp = strcmp(a->entry.name->data, b->entry.name->data);
+    if (cmp != 0) return cmp;
+    return (a->order > b->order) - (a->order < b->order);
+}
+
+// One merge pass over the listing for the whole batch, so a directory that churns thousands
+// of files costs a sort of the changes and a copy of the listing per frame at most
+static void fb_apply_changes(File_Browser *fb)
+{
+    File_Changes *changes = &fb->changes;
+    qsort(changes->items, changes->count, sizeof(*changes->items), change_cmp);
+
+    size_t count = 0;
+    for (size_t i = 0; i < changes->count; ++i) {
+        File_Change change = changes->items[i];
+        if (i + 1 < changes->count && strcmp(change.entry.name->data, changes->items[i + 1].entry.name->data) == 0) continue;
+
+        // Anything gone by now has a delete queued that is not worth waiting for
+        if (change.exists && change.entry.type != FT_DIRECTORY) {
+            const char *path = frame_sprintf("%s/%s", fb->dir_path.items, change.entry.name->data);
+            if (type_of_file(path, &change.entry.type) != 0) change.exists = false;
+        }
+        changes->items[count++] = change;
+    }
+
+    const Files *files = &fb->files;
+    Files *merged = &fb->merged;
+    merged->count = 0;
+    size_t cursor = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < files->count || j < count) {
+        int cmp;
+        if (i >= files->count) cmp = 1;
+        else if (j >= count) cmp = -1;
+        else cmp = strcmp(files->items[i].name->data, changes->items[j].entry.name->data);
+
+        // A deleted entry under the cursor hands it over to the one after it
+        if (cmp <= 0 && i == fb->cursor) cursor = merged->count;
+
+        if (cmp < 0) {
+            da_append(merged, files->items[i]);
+            i += 1;
+            continue;
+        }
+
+        // The names of the changes are in the frame arena, only the ones that made it into
+        // the listing are worth keeping
+        File_Change *change = &changes->items[j];
+        if (cmp == 0) {
+            if (change->exists) {
+                change->entry.name = files->items[i].name;
+            } else {
+                fb->names_live -= file_name_size(files->items[i].name);
+            }
+            i += 1;
+        } else if (change->exists) {
+            change->entry.name = file_name_new(&fb->names, change->entry.name->data, change->entry.name->len);
+            fb->names_size += file_name_size(change->entry.name);
+            fb->names_live += file_name_size(change->entry.name);
+        }
+        if (change->exists) da_append(merged, change->entry);
+        j += 1;
+    }
+
+    SWAP(Files, fb->files, fb->merged);
+    fb_compact_names(fb);
+    if (cursor >= fb->files.count) cursor = fb->files.count > 0 ? fb->files.count - 1 : 0;
+    fb->cursor = cursor;
+    fb_find_longest(fb);
+    changes->count = 0;
+}
+
+// The kernel dropped some events, only reading the directory again can tell what happened
+static void fb_reload(File_Browser *fb)
+{
+    // The names of the old listing go away along with it
+    const char *cursor_name = NULL;
+    if (fb->cursor < fb->files.count) cursor_name = frame_sprintf("%s", fb->files.items[fb->cursor].name->data);
+
+    fb->files.count = 0;
+    fb->changes.count = 0;
+    arena_reset(&fb->names);
+    Errno err = read_entire_dir(fb->dir_path.items, &fb->files, &fb->names);
+    if (err != 0) {
+        fprintf(stderr, "Could not read directory %s: %s\n", fb->dir_path.items, strerror(err));
+    }
+    fb_sort_files(fb);
+    fb_count_names(fb);
+
+    fb->cursor = 0;
+    if (cursor_name != NULL) fb->cursor = fb_lower_bound(fb, cursor_name);
+    if (fb->cursor >= fb->files.count) fb->cursor = fb->files.count > 0 ? fb->files.count - 1 : 0;
+}
+
+#ifdef __linux__
+// Until fb_apply_changes() tells whether the name survives the batch
+static const File_Name *frame_file_name(const char *name, size_t len)
+{
+    File_Name *result = frame_alloc(sizeof(File_Name) + len + 1);
+    result->len = (uint32_t)len;
+    memcpy(result->data, name, len);
+    result->data[len] = '\0';
+    return result;
+}
+#endif // __linux__
+
+void fb_poll_changes(File_Browser *fb)
+{
+#ifdef __linux__
+    if (!fb->watching || fb->watch < 0) return;
+
+    _Alignas(struct inotify_event) char buffer[16 * 1024];
+    bool overflow = false;
+    for (;;) {
+        ssize_t n = read(fb->watch_fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+
+        for (char *p = buffer; p < buffer + n;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(*event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) overflow = true;
+            if (event->wd != fb->watch || event->len == 0) continue;
+
+            File_Change change = {0};
+            change.entry.name = frame_file_name(event->name, strlen(event->name));
+            change.entry.type = (event->mask & IN_ISDIR) ? FT_DIRECTORY : FT_REGULAR;
+            change.exists = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+            change.order = fb->changes.count;
+            da_append(&fb->changes, change);
+        }
+    }
+
+    if (overflow) fb_reload(fb);
+    else if (fb->changes.count > 0) fb_apply_changes(fb);
+#else
+    UNUSED(fb);
+#endif // __linux__
+}
+
+void fb_render(const File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
 {
     Vec2f cursor_pos = vec2f(0, -(float)fb->cursor * FREE_GLYPH_FONT_SIZE);
 
-    int w, h;
-    SDL_GetWindowSize(window, &w, &h);
+    // The resolution is kept up to date by whoever owns the framebuffer
+    int w = (int)sr->resolution.x;
 
     float max_line_len = 0.0f;
 
-    sr->resolution = vec2f(w, h);
     sr->time = (float)SDL_GetTicks() / 1000.0f;
 
     simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
     if (fb->cursor < fb->files.count)
     {
+        const File_Entry *entry = &fb->files.items[fb->cursor];
         const Vec2f begin = vec2f(0, -((float)fb->cursor + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE);
         Vec2f end = begin;
-        free_glyph_atlas_measure_line_sized(
-            atlas, fb->files.items[fb->cursor], strlen(fb->files.items[fb->cursor]),
-            &end);
+        free_glyph_atlas_measure_line_sized(atlas, entry->name->data, entry->name->len, &end);
         simple_renderer_solid_rect(sr, begin, vec2f(end.x - begin.x, FREE_GLYPH_FONT_SIZE), hex_to_vec4f(0x494d64ff));
     }
-    simple_renderer_flush(sr);
+
+    // The camera fits the longest name, which is the widest one in a monospace font
+    if (fb->files.count > 0) {
+        const File_Entry *entry = &fb->files.items[fb->longest];
+        Vec2f end = vec2fs(0.0f);
+        free_glyph_atlas_measure_line_sized(atlas, entry->name->data, entry->name->len, &end);
+        max_line_len = fabsf(end.x);
+    }
+
+    // Only the rows on the screen, with one more on either side for the glyphs that stick out
+    size_t first_row = 0;
+    size_t last_row = 0;
+    {
+        float half_height = sr->resolution.y * 0.5f / sr->camera_scale;
+        float top = -(sr->camera_pos.y + half_height) / FREE_GLYPH_FONT_SIZE - 1.0f;
+        float bottom = -(sr->camera_pos.y - half_height) / FREE_GLYPH_FONT_SIZE + 2.0f;
+        if (top > 0.0f) first_row = (size_t)top;
+        if (bottom > 0.0f) last_row = (size_t)bottom;
+        if (last_row > fb->files.count) last_row = fb->files.count;
+    }
 
     simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
-    for (size_t row = 0; row < fb->files.count; ++row) {
+    for (size_t row = first_row; row < last_row; ++row) {
+        const File_Entry *entry = &fb->files.items[row];
         Vec4f color;
-        File_Type ft;
-        type_of_file(fb->files.items[row], &ft);
-        switch (ft)
+        switch (entry->type)
         {
             case FT_DIRECTORY:
                 color = hex_to_vec4f(0xcdd6f4ff);
@@ -175,15 +433,12 @@ void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atl
                 color = hex_to_vec4f(0xcad3f5ff);
                 break;
         }
-        if (fb->files.items[row][0] == '.' && isalnum(fb->files.items[row][1])) {
+        if (entry->name->data[0] == '.' && isalnum(entry->name->data[1])) {
             color = hex_to_vec4f(0x8087a2ff);
         }
 
-        const Vec2f begin = vec2f(0, -(float)row * FREE_GLYPH_FONT_SIZE);
-        Vec2f end = begin;
-        free_glyph_atlas_render_line_sized(atlas, sr, fb->files.items[row], strlen(fb->files.items[row]),&end, color);
-        float line_len = fabsf(end.x - begin.x);
-        if (line_len > max_line_len) max_line_len = line_len;
+        Vec2f end = vec2f(0, -(float)row * FREE_GLYPH_FONT_SIZE);
+        free_glyph_atlas_render_line_sized(atlas, sr, entry->name->data, entry->name->len, &end, color);
     }
 
     simple_renderer_flush(sr);
@@ -211,8 +466,8 @@ void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atl
         sr->camera_vel = vec2f_mul(vec2f_sub(target, sr->camera_pos), vec2fs(2.0f));
         sr->camera_scale_vel = (target_scale - sr->camera_scale) * 2.0f;
 
-        sr->camera_pos = vec2f_add(sr->camera_pos, vec2f_mul(sr->camera_vel, vec2fs(DELTA_TIME)));
-        sr->camera_scale = sr->camera_scale + sr->camera_scale_vel * DELTA_TIME;
+        sr->camera_pos = vec2f_add(sr->camera_pos, vec2f_mul(sr->camera_vel, vec2fs(sr->delta_time)));
+        sr->camera_scale = sr->camera_scale + sr->camera_scale_vel * sr->delta_time;
     }
 }
 
@@ -226,7 +481,7 @@ const char *fb_file_path(File_Browser *fb)
     fb->file_path.count = 0;
     sb_append_buf(&fb->file_path, fb->dir_path.items, fb->dir_path.count - 1);
     sb_append_buf(&fb->file_path, "/", 1);
-    sb_append_cstr(&fb->file_path, fb->files.items[fb->cursor]);
+    sb_append_buf(&fb->file_path, fb->files.items[fb->cursor].name->data, fb->files.items[fb->cursor].name->len);
     sb_append_null(&fb->file_path);
 
     return fb->file_path.items;
@@ -0,0 +1,776 @@
+// d_type, dirfd() and fstatat() are not visible with -std=c11 otherwise
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <minirent.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+#include <SDL2/SDL.h>
+#include "finder.h"
+#include "common.h"
+#include "arena.h"
+#include "sv.h"
+
+// The index is appended to in chunks that never move, so the ranking can read the published
+// part of it while the crawler keeps on appending without any locking
+#define FINDER_CHUNK_BITS 16
+#define FINDER_CHUNK_SIZE ((size_t)1 << FINDER_CHUNK_BITS)
+#define FINDER_CHUNKS_CAP 1024
+
+#define FINDER_QUERY_CAP 128
+#define FINDER_RESULTS_CAP 64
+#define FINDER_VISIBLE_RESULTS 12
+#define FINDER_BATCH_SIZE 16384 // candidates ranked by all the threads at once
+#define FINDER_SLICE_SIZE 1024  // candidates a thread takes from the batch at once
+#define FINDER_BUDGET_MS 4.0
+#define FINDER_MAX_WORKERS 15
+
+#define FINDER_SCORE_MATCH 16
+#define FINDER_SCORE_CONSECUTIVE 16
+#define FINDER_SCORE_WORD_START 12
+#define FINDER_SCORE_FILE_NAME 8
+
+// The palette is laid out in screen pixels, the text is the atlas scaled down to this
+#define FINDER_SCALE 0.35f
+#define FINDER_PADDING 8.0f
+#define FINDER_LINE_HEIGHT (FREE_GLYPH_FONT_SIZE * FINDER_SCALE * 1.3f)
+
+// Never worth indexing and often huge
+static const char *skipped_dirs[] = {
+    ".git", ".hg", ".svn", "node_modules", "vendor", "third_party",
+};
+
+typedef struct
+{
+    const char *path;
+    uint32_t len;
+    uint32_t name; // where the file name starts in the path
+    uint64_t mask;
+} Finder_Path;
+
+typedef struct
+{
+    const char *pattern;
+    size_t base_len; // the directory of the .gitignore relative to the root, the rule only applies below it
+    bool negate;
+    bool dir_only;
+    bool anchored; // matched against the path relative to the base instead of just the name
+} Ignore_Rule;
+
+typedef struct
+{
+    Ignore_Rule *items;
+    size_t count;
+    size_t capacity;
+} Ignore_Rules;
+
+typedef struct
+{
+    uint32_t id;
+    int32_t score;
+} Finder_Match;
+
+typedef struct
+{
+    Finder_Match *items;
+    size_t count;
+    size_t capacity;
+} Finder_Matches;
+
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Finder_Ids;
+
+static struct
+{
+    // Written by the crawler, read by everyone up to the published count
+    bool indexing;
+    SDL_atomic_t count;
+    SDL_atomic_t crawled;
+    Finder_Path *chunks[FINDER_CHUNKS_CAP];
+
+    // Only touched by the crawler
+    Arena arena;
+    Ignore_Rules rules;
+    String_Builder path;
+
+    bool opened;
+    String_Builder query;
+    uint64_t query_mask;
+    size_t cursor;
+
+    // The candidates of the query that are left to rank: the ids in source from source_next
+    // on, and then every indexed path from frontier on
+    Finder_Ids source;
+    size_t source_next;
+    size_t frontier;
+    // Every ranked candidate that matched, a longer query only needs to look at these
+    Finder_Ids matched;
+    Finder_Ids spare;
+    Finder_Match top[FINDER_RESULTS_CAP];
+    size_t top_count;
+
+    // The batch in flight. Either the ids or the range of the index from first on.
+    const uint32_t *batch_ids;
+    size_t batch_first;
+    size_t batch_count;
+    SDL_atomic_t next_slice;
+    // One per thread with the main thread at index 0
+    Finder_Matches results[FINDER_MAX_WORKERS + 1];
+
+    bool workers_started;
+    SDL_mutex *mutex;
+    SDL_cond *wake;
+    SDL_cond *done;
+    uint64_t generation;
+    size_t busy;
+    size_t workers_count;
+} finder = {0};
+
+static char lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// One bit per letter and digit and a few shared ones for everything else. A path can only
+// match a query that has none of the bits the path lacks, which rules out most of the index
+// with a single AND before the actual matching.
+static uint64_t char_mask(char c)
+{
+    unsigned char l = (unsigned char)lower(c);
+    if (l >= 'a' && l <= 'z') return 1ULL << (l - 'a');
+    if (l >= '0' && l <= '9') return 1ULL << (26 + l - '0');
+    return 1ULL << (36 + l % 28);
+}
+
+static const Finder_Path *finder_path(uint32_t id)
+{
+    return &finder.chunks[id >> FINDER_CHUNK_BITS][id & (FINDER_CHUNK_SIZE - 1)];
+}
+
+static size_t finder_indexed(void)
+{
+    size_t count = (size_t)SDL_AtomicGet(&finder.count);
+    SDL_MemoryBarrierAcquire();
+    return count;
+}
+
+// gitignore flavored globbing: `*` and `?` do not cross slashes, `**` does
+static bool glob_match(const char *pattern, const char *text)
+{
+    while (*pattern != '\0') {
+        switch (*pattern) {
+        case '*':
+            if (pattern[1] == '*') {
+                const char *rest = pattern + 2;
+                // `**/` matches no directories at all too
+                if (*rest == '/' && glob_match(rest + 1, text)) return true;
+                for (;; ++text) {
+                    if (glob_match(rest, text)) return true;
+                    if (*text == '\0') return false;
+                }
+            }
+            for (;; ++text) {
+                if (glob_match(pattern + 1, text)) return true;
+                if (*text == '\0' || *text == '/') return false;
+            }
+
+        case '?':
+            if (*text == '\0' || *text == '/') return false;
+            break;
+
+        case '[': {
+            if (*text == '\0' || *text == '/') return false;
+            const char *p = pattern + 1;
+            bool negate = *p == '!' || *p == '^';
+            if (negate) p += 1;
+            bool matched = false;
+            // A `]` right after the `[` is a literal one
+            do {
+                if (*p == '\0') return false;
+                if (p[1] == '-' && p[2] != '\0' && p[2] != ']') {
+                    if (p[0] <= *text && *text <= p[2]) matched = true;
+                    p += 3;
+                } else {
+                    if (*p == *text) matched = true;
+                    p += 1;
+                }
+            } while (*p != ']');
+            if (matched == negate) return false;
+            pattern = p;
+        } break;
+
+        case '\\':
+            if (pattern[1] != '\0') pattern += 1;
+            // fallthrough
+        default:
+            if (*pattern != *text) return false;
+        }
+
+        pattern += 1;
+        text += 1;
+    }
+    return *text == '\0';
+}
+
+static bool is_blank(char x)
+{
+    return x == ' ' || x == '\t' || x == '\r';
+}
+
+static void crawl_load_gitignore(size_t base_len)
+{
+    String_Builder *path = &finder.path;
+    sb_append_cstr(path, base_len > 0 ? "/.gitignore" : ".gitignore");
+    sb_append_null(path);
+
+    String_Builder content = {0};
+    Errno err = read_entire_file(path->items, &content);
+    if (err != 0 && err != ENOENT) fprintf(stderr, "WARNING: Could not read %s: %s\n", path->items, strerror(err));
+    path->count = base_len;
+    if (err != 0) {
+        free(content.items);
+        return;
+    }
+
+    String_View lines = sb_to_sv(content);
+    while (lines.count > 0) {
+        String_View line = sv_chop_by_delim(&lines, '\n');
+        // Trailing spaces only count when they are escaped, which is rare enough to not bother
+        while (line.count > 0 && is_blank(line.data[line.count - 1])) line.count -= 1;
+        if (line.count == 0 || line.data[0] == '#') continue;
+
+        Ignore_Rule rule = {0};
+        rule.base_len = base_len;
+        if (line.data[0] == '!') {
+            rule.negate = true;
+            sv_chop_left(&line, 1);
+        } else if (line.data[0] == '\\') {
+            sv_chop_left(&line, 1);
+        }
+        if (line.count > 0 && line.data[line.count - 1] == '/') {
+            rule.dir_only = true;
+            line.count -= 1;
+        }
+        size_t slash;
+        rule.anchored = sv_index_of(line, '/', &slash);
+        if (line.count > 0 && line.data[0] == '/') sv_chop_left(&line, 1);
+        if (line.count == 0) continue;
+
+        char *pattern = arena_alloc(&finder.arena, line.count + 1);
+        memcpy(pattern, line.data, line.count);
+        pattern[line.count] = '\0';
+        rule.pattern = pattern;
+        da_append(&finder.rules, rule);
+    }
+
+    free(content.items);
+}
+
+// The last rule that matches decides, like in git
+static bool crawl_ignored(const char *path, const char *name, bool dir)
+{
+    for (size_t i = finder.rules.count; i > 0; --i) {
+        const Ignore_Rule *rule = &finder.rules.items[i - 1];
+        if (rule->dir_only && !dir) continue;
+        const char *subject = name;
+        if (rule->anchored) subject = path + rule->base_len + (rule->base_len > 0);
+        if (glob_match(rule->pattern, subject)) return !rule->negate;
+    }
+    return false;
+}
+
+static void crawl_add_path(size_t name)
+{
+    size_t count = (size_t)SDL_AtomicGet(&finder.count);
+    if (count >= FINDER_CHUNK_SIZE * FINDER_CHUNKS_CAP) return;
+
+    Finder_Path **chunk = &finder.chunks[count >> FINDER_CHUNK_BITS];
+    if (*chunk == NULL) {
+        *chunk = malloc(FINDER_CHUNK_SIZE * sizeof(Finder_Path));
+        assert(*chunk != NULL && "Buy more RAM lol");
+    }
+
+    Finder_Path *p = &(*chunk)[count & (FINDER_CHUNK_SIZE - 1)];
+    char *copy = arena_alloc(&finder.arena, finder.path.count + 1);
+    memcpy(copy, finder.path.items, finder.path.count);
+    copy[finder.path.count] = '\0';
+    p->path = copy;
+    p->len = (uint32_t)finder.path.count;
+    p->name = (uint32_t)name;
+    p->mask = 0;
+    for (size_t i = 0; i < finder.path.count; ++i) p->mask |= char_mask(copy[i]);
+
+    // The path has to be visible to the other threads before the count that covers it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&finder.count, (int)(count + 1));
+}
+
+#ifndef _WIN32
+// The symlinks to directories are not followed, they may lead out of the tree or into a cycle
+static File_Type crawl_entry_type(DIR *dir, const struct dirent *ent)
+{
+#ifdef DT_DIR
+    switch (ent->d_type) {
+    case DT_REG: return FT_REGULAR;
+    case DT_DIR: return FT_DIRECTORY;
+    case DT_LNK:
+    case DT_UNKNOWN: break;
+    default: return FT_OTHER;
+    }
+#endif // DT_DIR
+
+    struct stat sb = {0};
+    if (fstatat(dirfd(dir), ent->d_name, &sb, AT_SYMLINK_NOFOLLOW) < 0) return FT_OTHER;
+    if (S_ISREG(sb.st_mode)) return FT_REGULAR;
+    if (S_ISDIR(sb.st_mode)) return FT_DIRECTORY;
+    if (!S_ISLNK(sb.st_mode)) return FT_OTHER;
+    if (fstatat(dirfd(dir), ent->d_name, &sb, 0) < 0) return FT_OTHER;
+    return S_ISREG(sb.st_mode) ? FT_REGULAR : FT_OTHER;
+}
+#endif // _WIN32
+
+static bool skipped_dir(const char *name)
+{
+    for (size_t i = 0; i < sizeof(skipped_dirs) / sizeof(skipped_dirs[0]); ++i) {
+        if (strcmp(name, skipped_dirs[i]) == 0) return true;
+    }
+    return false;
+}
+
+// finder.path is the directory relative to the root, empty for the root itself
+static void crawl_dir(void)
+{
+    String_Builder *path = &finder.path;
+    const size_t dir_len = path->count;
+    const size_t rules_count = finder.rules.count;
+    crawl_load_gitignore(dir_len);
+
+    sb_append_null(path);
+    DIR *dir = opendir(dir_len > 0 ? path->items : ".");
+    path->count = dir_len;
+    if (dir == NULL) {
+        fprintf(stderr, "WARNING: Could not index %s: %s\n", dir_len > 0 ? path->items : ".", strerror(errno));
+        finder.rules.count = rules_count;
+        return;
+    }
+
+    // The subdirectories are crawled after the directory is closed, so a deep tree does not
+    // keep a descriptor open per level. Their names are kept back to back.
+    String_Builder subdirs = {0};
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        const char *name = ent->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+#ifdef _WIN32
+        // TODO: type of the directory entries on Windows
+        File_Type type = FT_OTHER;
+#else
+        File_Type type = crawl_entry_type(dir, ent);
+#endif // _WIN32
+        if (type == FT_OTHER) continue;
+        if (type == FT_DIRECTORY && skipped_dir(name)) continue;
+
+        if (dir_len > 0) sb_append_cstr(path, "/");
+        size_t name_begin = path->count;
+        sb_append_cstr(path, name);
+        sb_append_null(path);
+        path->count -= 1;
+
+        if (!crawl_ignored(path->items, name, type == FT_DIRECTORY)) {
+            if (type == FT_DIRECTORY) {
+                sb_append_cstr(&subdirs, name);
+                sb_append_null(&subdirs);
+            } else {
+                crawl_add_path(name_begin);
+            }
+        }
+        path->count = dir_len;
+    }
+    closedir(dir);
+
+    for (size_t i = 0; i < subdirs.count; i += strlen(subdirs.items + i) + 1) {
+        if (dir_len > 0) sb_append_cstr(path, "/");
+        sb_append_cstr(path, subdirs.items + i);
+        crawl_dir();
+        path->count = dir_len;
+    }
+
+    free(subdirs.items);
+    finder.rules.count = rules_count;
+}
+
+static int finder_crawler(void *data)
+{
+    UNUSED(data);
+    crawl_dir();
+    SDL_AtomicSet(&finder.crawled, 1);
+    return 0;
+}
+
+void finder_start_indexing(void)
+{
+    if (finder.indexing) return;
+    finder.indexing = true;
+
+    SDL_Thread *thread = SDL_CreateThread(finder_crawler, "finder_crawler", NULL);
+    if (thread == NULL) {
+        fprintf(stderr, "WARNING: Could not start the file indexer: %s\n", SDL_GetError());
+        SDL_AtomicSet(&finder.crawled, 1);
+        return;
+    }
+    SDL_DetachThread(thread);
+}
+
+static bool is_word_start(const char *path, size_t at)
+{
+    if (at == 0) return true;
+    char prev = path[at - 1];
+    if (prev == '/' || prev == '_' || prev == '-' || prev == '.' || prev == ' ') return true;
+    // camelCase
+    return 'a' <= prev && prev <= 'z' && 'A' <= path[at] && path[at] <= 'Z';
+}
+
+// Finds the query as a subsequence of the path, case insensitively. Matching from the end
+// finds it in the file name first if it is there, which is what people usually type.
+static bool fuzzy_match(const char *query, size_t query_len, const Finder_Path *p, int32_t *score, size_t *positions)
+{
+    size_t at = p->len;
+    size_t prev = SIZE_MAX;
+    int32_t s = 0;
+    for (size_t i = query_len; i > 0; --i) {
+        char q = lower(query[i - 1]);
+        while (at > 0 && lower(p->path[at - 1]) != q) at -= 1;
+        if (at == 0) return false;
+        at -= 1;
+
+        s += FINDER_SCORE_MATCH;
+        if (prev == at + 1) s += FINDER_SCORE_CONSECUTIVE;
+        if (is_word_start(p->path, at)) s += FINDER_SCORE_WORD_START;
+        if (at >= p->name) s += FINDER_SCORE_FILE_NAME;
+        if (positions) positions[i - 1] = at;
+        prev = at;
+    }
+    *score = s;
+    return true;
+}
+
+// The higher score, then the shorter path, then the one indexed first
+static bool match_better(Finder_Match a, Finder_Match b)
+{
+    if (a.score != b.score) return a.score > b.score;
+    uint32_t a_len = finder_path(a.id)->len;
+    uint32_t b_len = finder_path(b.id)->len;
+    if (a_len != b_len) return a_len < b_len;
+    return a.id < b.id;
+}
+
+static void finder_top_insert(Finder_Match match)
+{
+    if (finder.top_count == FINDER_RESULTS_CAP && !match_better(match, finder.top[FINDER_RESULTS_CAP - 1])) return;
+
+    size_t i = finder.top_count < FINDER_RESULTS_CAP ? finder.top_count++ : FINDER_RESULTS_CAP - 1;
+    while (i > 0 && match_better(match, finder.top[i - 1])) {
+        finder.top[i] = finder.top[i - 1];
+        i -= 1;
+    }
+    finder.top[i] = match;
+}
+
+static void finder_rank_slices(size_t thread_index)
+{
+    Finder_Matches *results = &finder.results[thread_index];
+    const char *query = finder.query.items;
+    const size_t query_len = finder.query.count;
+    const uint64_t query_mask = finder.query_mask;
+
+    for (;;) {
+        size_t begin = (size_t)SDL_AtomicAdd(&finder.next_slice, FINDER_SLICE_SIZE);
+        if (begin >= finder.batch_count) break;
+        size_t end = begin + FINDER_SLICE_SIZE;
+        if (end > finder.batch_count) end = finder.batch_count;
+
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t id = finder.batch_ids ? finder.batch_ids[i] : (uint32_t)(finder.batch_first + i);
+            const Finder_Path *p = finder_path(id);
+            if ((p->mask & query_mask) != query_mask) continue;
+            Finder_Match match = {.id = id};
+            if (fuzzy_match(query, query_len, p, &match.score, NULL)) da_append(results, match);
+        }
+    }
+}
+
+// The workers are parked on the condition variable in between the batches for as long as the
+// process lives
+static int finder_worker(void *data)
+{
+    size_t index = (size_t)(uintptr_t)data;
+    uint64_t seen = 0;
+
+    for (;;) {
+        SDL_LockMutex(finder.mutex);
+        while (finder.generation == seen) SDL_CondWait(finder.wake, finder.mutex);
+        seen = finder.generation;
+        SDL_UnlockMutex(finder.mutex);
+
+        finder_rank_slices(index);
+
+        SDL_LockMutex(finder.mutex);
+        finder.busy -= 1;
+        if (finder.busy == 0) SDL_CondSignal(finder.done);
+        SDL_UnlockMutex(finder.mutex);
+    }
+
+    return 0;
+}
+
+static void finder_start_workers(void)
+{
+    if (finder.workers_started) return;
+    finder.workers_started = true;
+
+    finder.mutex = SDL_CreateMutex();
+    finder.wake = SDL_CreateCond();
+    finder.done = SDL_CreateCond();
+
+    int workers_count = SDL_GetCPUCount() - 1;
+    if (workers_count < 0) workers_count = 0;
+    if (workers_count > FINDER_MAX_WORKERS) workers_count = FINDER_MAX_WORKERS;
+    for (int i = 0; i < workers_count; ++i) {
+        SDL_Thread *thread = SDL_CreateThread(finder_worker, "finder_ranker", (void *)(uintptr_t)(finder.workers_count + 1));
+        if (thread == NULL) {
+            fprintf(stderr, "WARNING: could not start a file finder thread: %s\n", SDL_GetError());
+            break;
+        }
+        SDL_DetachThread(thread);
+        finder.workers_count += 1;
+    }
+}
+
+static void finder_rank_batch(void)
+{
+    for (size_t i = 0; i <= finder.workers_count; ++i) finder.results[i].count = 0;
+    SDL_AtomicSet(&finder.next_slice, 0);
+
+    // Not worth waking anybody up for a single slice
+    bool parallel = finder.workers_count > 0 && finder.batch_count > FINDER_SLICE_SIZE;
+    if (parallel) {
+        SDL_LockMutex(finder.mutex);
+        finder.busy = finder.workers_count;
+        finder.generation += 1;
+        SDL_CondBroadcast(finder.wake);
+        SDL_UnlockMutex(finder.mutex);
+    }
+
+    finder_rank_slices(0);
+
+    if (parallel) {
+        SDL_LockMutex(finder.mutex);
+        while (finder.busy > 0) SDL_CondWait(finder.done, finder.mutex);
+        SDL_UnlockMutex(finder.mutex);
+    }
+
+    for (size_t i = 0; i <= finder.workers_count; ++i) {
+        const Finder_Matches *results = &finder.results[i];
+        for (size_t j = 0; j < results->count; ++j) {
+            da_append(&finder.matched, results->items[j].id);
+            finder_top_insert(results->items[j]);
+        }
+    }
+}
+
+// Starts ranking the query from scratch against the whole index
+static void finder_reset(void)
+{
+    finder.source.count = 0;
+    finder.source_next = 0;
+    finder.frontier = 0;
+    finder.matched.count = 0;
+    finder.top_count = 0;
+    finder.cursor = 0;
+
+    finder.query_mask = 0;
+    for (size_t i = 0; i < finder.query.count; ++i) finder.query_mask |= char_mask(finder.query.items[i]);
+}
+
+void finder_open(void)
+{
+    finder_start_indexing();
+    finder_start_workers();
+    finder.opened = true;
+    finder.query.count = 0;
+    finder_reset();
+}
+
+void finder_close(void)
+{
+    finder.opened = false;
+}
+
+bool finder_opened(void)
+{
+    return finder.opened;
+}
+
+void finder_insert_text(const char *text)
+{
+    bool was_empty = finder.query.count == 0;
+    for (; *text != '\0' && finder.query.count < FINDER_QUERY_CAP; ++text) {
+        if (*text < ' ' || *text > '~') continue;
+        da_append(&finder.query, *text);
+    }
+
+    if (was_empty) {
+        finder_reset();
+        return;
+    }
+
+    // Whatever matches the longer query matches the shorter one too, so the candidates are
+    // only the matches so far plus the candidates that were not ranked yet
+    finder.spare.count = 0;
+    da_append_many(&finder.spare, finder.matched.items, finder.matched.count);
+    da_append_many(&finder.spare, finder.source.items + finder.source_next, finder.source.count - finder.source_next);
+    SWAP(Finder_Ids, finder.source, finder.spare);
+    finder.source_next = 0;
+    finder.matched.count = 0;
+    finder.top_count = 0;
+    finder.cursor = 0;
+    for (size_t i = 0; i < finder.query.count; ++i) finder.query_mask |= char_mask(finder.query.items[i]);
+}
+
+void finder_backspace(void)
+{
+    if (finder.query.count == 0) return;
+    finder.query.count -= 1;
+    finder_reset();
+}
+
+void finder_move_cursor(int delta)
+{
+    if (delta < 0 && finder.cursor > 0) finder.cursor -= 1;
+    if (delta > 0 && finder.cursor + 1 < finder.top_count) finder.cursor += 1;
+}
+
+const char *finder_selected_path(void)
+{
+    if (finder.cursor >= finder.top_count) return NULL;
+    return finder_path(finder.top[finder.cursor].id)->path;
+}
+
+static bool finder_ranking(void)
+{
+    return finder.query.count > 0 && (finder.source_next < finder.source.count || finder.frontier < finder_indexed());
+}
+
+void finder_update(void)
+{
+    if (!finder.opened) return;
+    const size_t indexed = finder_indexed();
+
+    // Everything matches an empty query, it just shows the index in the order it was crawled
+    if (finder.query.count == 0) {
+        finder.top_count = indexed < FINDER_RESULTS_CAP ? indexed : FINDER_RESULTS_CAP;
+        for (size_t i = 0; i < finder.top_count; ++i) finder.top[i] = (Finder_Match) {.id = (uint32_t)i};
+        return;
+    }
+
+    const Uint64 deadline = SDL_GetPerformanceCounter() + (Uint64)(FINDER_BUDGET_MS * (double)SDL_GetPerformanceFrequency() / 1000.0);
+    do {
+        if (finder.source_next < finder.source.count) {
+            finder.batch_ids = finder.source.items + finder.source_next;
+            finder.batch_count = finder.source.count - finder.source_next;
+            if (finder.batch_count > FINDER_BATCH_SIZE) finder.batch_count = FINDER_BATCH_SIZE;
+            finder.source_next += finder.batch_count;
+        } else if (finder.frontier < indexed) {
+            finder.batch_ids = NULL;
+            finder.batch_first = finder.frontier;
+            finder.batch_count = indexed - finder.frontier;
+            if (finder.batch_count > FINDER_BATCH_SIZE) finder.batch_count = FINDER_BATCH_SIZE;
+            finder.frontier += finder.batch_count;
+        } else {
+            break;
+        }
+        finder_rank_batch();
+    } while (SDL_GetPerformanceCounter() < deadline);
+
+    if (finder.cursor >= finder.top_count) finder.cursor = finder.top_count > 0 ? finder.top_count - 1 : 0;
+}
+
+void finder_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas)
+{
+    if (!finder.opened) return;
+
+    simple_renderer_begin_overlay(sr, FINDER_SCALE);
+
+    size_t first = finder.cursor >= FINDER_VISIBLE_RESULTS ? finder.cursor - FINDER_VISIBLE_RESULTS + 1 : 0;
+    size_t last = first + FINDER_VISIBLE_RESULTS;
+    if (last > finder.top_count) last = finder.top_count;
+
+    const float x = FINDER_PADDING;
+    const float width = sr->resolution.x - 2 * FINDER_PADDING;
+    const float text_x = x + FINDER_PADDING;
+    float y = FINDER_PADDING;
+    const float height = (float)(2 + last - first) * FINDER_LINE_HEIGHT + 2 * FINDER_PADDING;
+
+    simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+    simple_renderer_overlay_rect(sr, x, y, width, height, hex_to_vec4f(0x181926f0));
+    if (first < last) {
+        float cursor_y = y + FINDER_PADDING + (float)(2 + finder.cursor - first) * FINDER_LINE_HEIGHT;
+        simple_renderer_overlay_rect(sr, x, cursor_y, width, FINDER_LINE_HEIGHT, hex_to_vec4f(0x494d64ff));
+    }
+
+    simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+    const Vec4f text_color = hex_to_vec4f(0xcad3f5ff);
+    const Vec4f dim_color = hex_to_vec4f(0x8087a2ff);
+    const Vec4f match_color = hex_to_vec4f(0xeed49fff);
+    y += FINDER_PADDING + FINDER_LINE_HEIGHT * 0.75f;
+
+    Vec2f pen = simple_renderer_overlay_point(sr, text_x, y);
+    free_glyph_atlas_render_line_sized(atlas, sr, "> ", 2, &pen, dim_color);
+    free_glyph_atlas_render_line_sized(atlas, sr, finder.query.items, finder.query.count, &pen, text_color);
+    y += FINDER_LINE_HEIGHT;
+
+    {
+        char status[128];
+        snprintf(status, sizeof(status), "%zu files%s%s", finder_indexed(),
+                 SDL_AtomicGet(&finder.crawled) ? "" : ", indexing...",
+                 finder_ranking() ? ", ranking..." : "");
+        pen = simple_renderer_overlay_point(sr, text_x, y);
+        free_glyph_atlas_render_line_sized(atlas, sr, status, strlen(status), &pen, dim_color);
+        y += FINDER_LINE_HEIGHT;
+    }
+
+    size_t positions[FINDER_QUERY_CAP];
+    for (size_t i = first; i < last; ++i) {
+        const Finder_Path *p = finder_path(finder.top[i].id);
+        pen = simple_renderer_overlay_point(sr, text_x, y);
+        int32_t score;
+        if (finder.query.count > 0 && fuzzy_match(finder.query.items, finder.query.count, p, &score, positions)) {
+            size_t begin = 0;
+            for (size_t k = 0; k < finder.query.count; ++k) {
+                free_glyph_atlas_render_line_sized(atlas, sr, p->path + begin, positions[k] - begin, &pen, text_color);
+                free_glyph_atlas_render_line_sized(atlas, sr, p->path + positions[k], 1, &pen, match_color);
+                begin = positions[k] + 1;
+            }
+            free_glyph_atlas_render_line_sized(atlas, sr, p->path + begin, p->len - begin, &pen, text_color);
+        } else {
+            free_glyph_atlas_render_line_sized(atlas, sr, p->path, p->len, &pen, text_color);
+        }
+        y += FINDER_LINE_HEIGHT;
+    }
+
+    simple_renderer_end_overlay(sr);
+}
@@ -1,107 +1,328 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <SDL2/SDL.h>
 #include "free_glyph.h"
+#include "common.h"
+#include "trace.h"
 
-void free_glyph_atlas_init(Free_Glyph_Atlas *atlas, FT_Face face)
+#define ATLAS_CACHE_MAGIC "DTYATLAS"
+#define ATLAS_CACHE_VERSION 1
+
+// Layout of the on-disk atlas cache. The header is followed by
+// atlas_width * atlas_height bytes of the single channel SDF bitmap.
+typedef struct
 {
-    // TODO: Introduction of SDF font slowed down the start up time
-    // We need to investigate what's up with that
-    FT_Int32 load_flags = FT_LOAD_RENDER | FT_LOAD_TARGET_(FT_RENDER_MODE_SDF);
-    for (int i = 32; i < 128; ++i)
+    char magic[8];
+    uint32_t version;
+    uint32_t render_mode;
+    uint32_t pixel_size;
+    uint32_t atlas_width;
+    uint32_t atlas_height;
+    uint32_t reserved;
+    uint64_t font_hash;
+    Glyph_Metric metrics[GLYPH_METRICS_CAPACITY];
+} Atlas_Cache_Header;
+
+static bool atlas_cache_key(Atlas_Cache_Header *key, FT_Face face, const char *font_file_path, FT_Render_Mode render_mode)
+{
+    String_Builder font = {0};
+    Errno err = read_entire_file(font_file_path, &font);
+    if (err != 0) {
+        fprintf(stderr, "WARNING: could not hash font `%s` for the atlas cache: %s\n", font_file_path, strerror(err));
+        free(font.items);
+        return false;
+    }
+
+    memset(key, 0, sizeof(*key));
+    memcpy(key->magic, ATLAS_CACHE_MAGIC, sizeof(key->magic));
+    key->version = ATLAS_CACHE_VERSION;
+    key->render_mode = render_mode;
+    key->pixel_size = face->size->metrics.y_ppem;
+    key->font_hash = hash_bytes(font.items, font.count);
+
+    free(font.items);
+    return true;
+}
+
+static bool atlas_cache_matches(const Atlas_Cache_Header *key, const Atlas_Cache_Header *header)
+{
+    return memcmp(header->magic, key->magic, sizeof(key->magic)) == 0
+        && header->version == key->version
+        && header->render_mode == key->render_mode
+        && header->pixel_size == key->pixel_size
+        && header->font_hash == key->font_hash;
+}
+
+static bool free_glyph_atlas_load_cache(Free_Glyph_Atlas *atlas, const Atlas_Cache_Header *key, const char *cache_path)
+{
+    const char *data = NULL;
+    size_t size = 0;
+    if (map_entire_file(cache_path, &data, &size) != 0) return false;
+
+    bool result = true;
+    const Atlas_Cache_Header *header = (const Atlas_Cache_Header *)data;
+    if (size < sizeof(*header) || !atlas_cache_matches(key, header)) return_defer(false);
+    if (size != sizeof(*header) + (size_t)header->atlas_width * header->atlas_height) return_defer(false);
+
+    atlas->atlas_width = header->atlas_width;
+    atlas->atlas_height = header->atlas_height;
+    memcpy(atlas->metrics, header->metrics, sizeof(atlas->metrics));
+    atlas->pixels = malloc((size_t)atlas->atlas_width * atlas->atlas_height);
+    assert(atlas->pixels != NULL && "Buy more RAM lol");
+    memcpy(atlas->pixels, data + sizeof(*header), (size_t)atlas->atlas_width * atlas->atlas_height);
+
+defer:
+    unmap_entire_file(data, size);
+    return result;
+}
+
+static void free_glyph_atlas_save_cache(const Free_Glyph_Atlas *atlas, const Atlas_Cache_Header *key, const char *cache_path, const uint8_t *pixels)
+{
+    Atlas_Cache_Header header = *key;
+    header.atlas_width = atlas->atlas_width;
+    header.atlas_height = atlas->atlas_height;
+    memcpy(header.metrics, atlas->metrics, sizeof(header.metrics));
+
+    String_Builder data = {0};
+    sb_append_buf(&data, (const char *)&header, sizeof(header));
+    sb_append_buf(&data, (const char *)pixels, (size_t)atlas->atlas_width * atlas->atlas_height);
+
+    // Write to a temporary file first, so a concurrently starting instance never maps a half written cache
+    String_Builder tmp_path = {0};
+    sb_append_cstr(&tmp_path, cache_path);
+    sb_append_cstr(&tmp_path, ".tmp");
+    sb_append_null(&tmp_path);
+
+    Errno err = write_entire_file(tmp_path.items, data.items, data.count);
+    if (err == 0 && rename(tmp_path.items, cache_path) < 0) err = errno;
+    if (err != 0) {
+        fprintf(stderr, "WARNING: could not save glyph atlas cache `%s`: %s\n", cache_path, strerror(err));
+        remove(tmp_path.items);
+    }
+
+    free(tmp_path.items);
+    free(data.items);
+}
+
+#define GLYPH_RANGE_BEGIN 32
+#define GLYPH_RANGE_END 128
+
+typedef struct
+{
+    Glyph_Metric metric;
+    unsigned int width;
+    unsigned int rows;
+    uint8_t *pixels; // tightly packed, width * rows
+} Rasterized_Glyph;
+
+typedef struct
+{
+    FT_Face face;
+    FT_Int32 load_flags;
+    SDL_atomic_t *next_glyph;
+    Rasterized_Glyph *glyphs;
+    int failed_glyph;
+} Rasterize_Job;
+
+// Renders glyphs until the shared counter runs out. Every job owns its FT_Face
+// (and FT_Library for the worker threads) since FreeType objects are not thread-safe.
+static int rasterize_glyphs(void *data)
+{
+    Rasterize_Job *job = data;
+    TRACE_BEGIN("rasterize_glyphs");
+    for (;;)
     {
-        if (FT_Load_Char(face, i, load_flags))
+        int i = GLYPH_RANGE_BEGIN + SDL_AtomicAdd(job->next_glyph, 1);
+        if (i >= GLYPH_RANGE_END) break;
+
+        if (FT_Load_Char(job->face, i, job->load_flags))
         {
-            fprintf(stderr, "ERROR: could not load glyph of a character with code %d\n", i);
-            exit(1);
+            job->failed_glyph = i;
+            TRACE_END("rasterize_glyphs");
+            return 1;
         }
 
-        atlas->atlas_width += face->glyph->bitmap.width;
-        if (atlas->atlas_height < face->glyph->bitmap.rows)
+        FT_GlyphSlot slot = job->face->glyph;
+        Rasterized_Glyph *glyph = &job->glyphs[i];
+        glyph->metric.ax = slot->advance.x >> 6;
+        glyph->metric.ay = slot->advance.y >> 6;
+        glyph->metric.bw = slot->bitmap.width;
+        glyph->metric.bh = slot->bitmap.rows;
+        glyph->metric.bl = slot->bitmap_left;
+        glyph->metric.bt = slot->bitmap_top;
+        glyph->width = slot->bitmap.width;
+        glyph->rows = slot->bitmap.rows;
+        glyph->pixels = malloc((size_t)glyph->width * glyph->rows + 1);
+        assert(glyph->pixels != NULL && "Buy more RAM lol");
+        for (unsigned int row = 0; row < glyph->rows; ++row)
         {
-            atlas->atlas_height = face->glyph->bitmap.rows;
+            memcpy(&glyph->pixels[(size_t)row * glyph->width],
+                   &slot->bitmap.buffer[(ptrdiff_t)row * slot->bitmap.pitch],
+                   glyph->width);
         }
     }
+    TRACE_END("rasterize_glyphs");
+    return 0;
+}
+
+typedef struct
+{
+    const char *font_file_path;
+    FT_UInt x_ppem;
+    FT_UInt y_ppem;
+    Rasterize_Job job;
+} Rasterize_Worker;
 
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(1, &atlas->glyphs_texture);
-    glBindTexture(GL_TEXTURE_2D, atlas->glyphs_texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RED,
-        (GLsizei)atlas->atlas_width,
-        (GLsizei)atlas->atlas_height,
-        0,
-        GL_RED,
-        GL_UNSIGNED_BYTE,
-        NULL);
-
-    int x = 0;
-    for (int i = 32; i < 128; ++i)
+static int rasterize_worker(void *data)
+{
+    Rasterize_Worker *worker = data;
+
+    FT_Library library;
+    if (FT_Init_FreeType(&library)) return 1;
+    int result = 1;
+    if (FT_New_Face(library, worker->font_file_path, 0, &worker->job.face) == 0)
     {
-        if (FT_Load_Char(face, i, load_flags))
+        if (FT_Set_Pixel_Sizes(worker->job.face, worker->x_ppem, worker->y_ppem) == 0)
         {
-            fprintf(stderr, "ERROR: could not load glyph of a character with code %d\n", i);
-            exit(1);
+            result = rasterize_glyphs(&worker->job);
         }
+        FT_Done_Face(worker->job.face);
+    }
+    FT_Done_FreeType(library);
+    return result;
+}
+
+static uint8_t *free_glyph_atlas_rasterize(Free_Glyph_Atlas *atlas, FT_Face face, const char *font_file_path, FT_Int32 load_flags)
+{
+    static Rasterized_Glyph glyphs[GLYPH_METRICS_CAPACITY];
+    memset(glyphs, 0, sizeof(glyphs));
+    SDL_atomic_t next_glyph = {0};
+
+    int workers_count = SDL_GetCPUCount() - 1;
+    if (workers_count < 0) workers_count = 0;
+    if (workers_count > (GLYPH_RANGE_END - GLYPH_RANGE_BEGIN) / 8) workers_count = (GLYPH_RANGE_END - GLYPH_RANGE_BEGIN) / 8;
 
-        if (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL))
+    Rasterize_Worker *workers = calloc(workers_count + 1, sizeof(*workers));
+    SDL_Thread **threads = calloc(workers_count + 1, sizeof(*threads));
+    assert(workers != NULL && threads != NULL && "Buy more RAM lol");
+    for (int i = 0; i < workers_count; ++i)
+    {
+        workers[i].font_file_path = font_file_path;
+        workers[i].x_ppem = face->size->metrics.x_ppem;
+        workers[i].y_ppem = face->size->metrics.y_ppem;
+        workers[i].job.load_flags = load_flags;
+        workers[i].job.next_glyph = &next_glyph;
+        workers[i].job.glyphs = glyphs;
+        threads[i] = SDL_CreateThread(rasterize_worker, "glyph rasterizer", &workers[i]);
+        if (threads[i] == NULL)
         {
-            fprintf(stderr, "ERROR: could not render glyph of a character with code %d\n", i);
-            exit(1);
+            fprintf(stderr, "WARNING: could not start glyph rasterizer thread: %s\n", SDL_GetError());
         }
+    }
 
-        atlas->metrics[i].ax = face->glyph->advance.x >> 6;
-        atlas->metrics[i].ay = face->glyph->advance.y >> 6;
-        atlas->metrics[i].bw = face->glyph->bitmap.width;
-        atlas->metrics[i].bh = face->glyph->bitmap.rows;
-        atlas->metrics[i].bl = face->glyph->bitmap_left;
-        atlas->metrics[i].bt = face->glyph->bitmap_top;
-        atlas->metrics[i].tx = (float)x / (float)atlas->atlas_width;
+    // The calling thread takes part in the work with the face it was given
+    Rasterize_Job job = {
+        .face = face,
+        .load_flags = load_flags,
+        .next_glyph = &next_glyph,
+        .glyphs = glyphs,
+    };
+    int failed_glyph = 0;
+    if (rasterize_glyphs(&job) != 0) failed_glyph = job.failed_glyph;
 
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexSubImage2D(
-            GL_TEXTURE_2D,
-            0,
-            x,
-            0,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer);
-        x += face->glyph->bitmap.width;
+    for (int i = 0; i < workers_count; ++i)
+    {
+        if (threads[i] == NULL) continue;
+        int status = 0;
+        SDL_WaitThread(threads[i], &status);
+        if (status == 0) continue;
+        if (workers[i].job.failed_glyph > 0)
+        {
+            if (failed_glyph == 0) failed_glyph = workers[i].job.failed_glyph;
+        }
+        else
+        {
+            // It gave up before claiming any glyphs, the others rasterized all of them
+            fprintf(stderr, "WARNING: could not load font `%s` in a glyph rasterizer thread\n", font_file_path);
+        }
     }
-}
+    free(threads);
+    free(workers);
 
-float free_glyph_atlas_cursor_pos(const Free_Glyph_Atlas *atlas, const char *text, size_t text_size, Vec2f pos, size_t col)
-{
-    for (size_t i = 0; i < text_size; ++i)
+    if (failed_glyph > 0)
+    {
+        fprintf(stderr, "ERROR: could not load glyph of a character with code %d\n", failed_glyph);
+        exit(1);
+    }
+
+    for (int i = GLYPH_RANGE_BEGIN; i < GLYPH_RANGE_END; ++i)
     {
-        if (i == col)
+        atlas->atlas_width += glyphs[i].width;
+        if (atlas->atlas_height < glyphs[i].rows)
         {
-            return pos.x;
+            atlas->atlas_height = glyphs[i].rows;
         }
+    }
 
-        size_t glyph_index = text[i];
-        if (glyph_index >= GLYPH_METRICS_CAPACITY)
+    uint8_t *pixels = calloc((size_t)atlas->atlas_width * atlas->atlas_height, 1);
+    assert(pixels != NULL && "Buy more RAM lol");
+
+    unsigned int x = 0;
+    for (int i = GLYPH_RANGE_BEGIN; i < GLYPH_RANGE_END; ++i)
+    {
+        atlas->metrics[i] = glyphs[i].metric;
+        atlas->metrics[i].tx = (float)x / (float)atlas->atlas_width;
+
+        for (unsigned int row = 0; row < glyphs[i].rows; ++row)
         {
-            glyph_index = '?';
+            memcpy(&pixels[(size_t)row * atlas->atlas_width + x],
+                   &glyphs[i].pixels[(size_t)row * glyphs[i].width],
+                   glyphs[i].width);
         }
+        x += glyphs[i].width;
+        free(glyphs[i].pixels);
+    }
 
-        Glyph_Metric metric = atlas->metrics[glyph_index];
-        pos.x += metric.ax;
-        pos.y += metric.ay;
+    return pixels;
+}
+
+void free_glyph_atlas_init(Free_Glyph_Atlas *atlas, FT_Face face, const char *font_file_path)
+{
+    // NOTE: Rasterizing SDF glyphs is slow enough to be noticeable on every start up,
+    // so the finished atlas is cached on disk keyed by the font content, size and render mode.
+    FT_Int32 load_flags = FT_LOAD_RENDER | FT_LOAD_TARGET_(FT_RENDER_MODE_SDF);
+    TRACE_BEGIN("free_glyph_atlas_init");
+
+    Atlas_Cache_Header key;
+    String_Builder cache_path = {0};
+    bool cached = atlas_cache_key(&key, face, font_file_path, FT_RENDER_MODE_SDF);
+    if (cached) {
+        char file_name[64];
+        snprintf(file_name, sizeof(file_name), "atlas-%016llx-%u-%u.bin",
+                 (unsigned long long)key.font_hash, key.pixel_size, key.render_mode);
+        Errno err = cache_file_path(file_name, &cache_path);
+        if (err != 0) {
+            fprintf(stderr, "WARNING: glyph atlas cache is not available: %s\n", strerror(err));
+            cached = false;
+        }
+    }
+
+    if (cached && free_glyph_atlas_load_cache(atlas, &key, cache_path.items)) {
+        free(cache_path.items);
+        TRACE_END("free_glyph_atlas_init");
+        return;
     }
 
-    return pos.x;
+    atlas->atlas_width = 0;
+    atlas->atlas_height = 0;
+    atlas->pixels = free_glyph_atlas_rasterize(atlas, face, font_file_path, load_flags);
+    if (cached) free_glyph_atlas_save_cache(atlas, &key, cache_path.items, atlas->pixels);
+
+    free(cache_path.items);
+    TRACE_END("free_glyph_atlas_init");
 }
 
 void free_glyph_atlas_measure_line_sized(Free_Glyph_Atlas *atlas, const char *text, size_t text_size, Vec2f *pos)
@@ -132,20 +353,25 @@ void free_glyph_atlas_render_line_sized(Free_Glyph_Atlas *atlas, Simple_Renderer
             glyph_index = '?';
         }
         Glyph_Metric metric = atlas->metrics[glyph_index];
-        float x2 = pos->x + metric.bl;
-        float y2 = -pos->y - metric.bt;
-        float w = metric.bw;
-        float h = metric.bh;
+
+        simple_renderer_glyph(sr, *pos, glyph_index, color);
 
         pos->x += metric.ax;
         pos->y += metric.ay;
+    }
+}
 
-        simple_renderer_image_rect(
-            sr,
-            vec2f(x2, -y2),
-            vec2f(w, -h),
-            vec2f(metric.tx, 0.0f),
-            vec2f(metric.bw / (float)atlas->atlas_width, metric.bh / (float)atlas->atlas_height),
-            color);
+void free_glyph_atlas_bind(const Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
+{
+    simple_renderer_set_glyph_atlas(sr, atlas->pixels, atlas->atlas_width, atlas->atlas_height);
+
+    Vec4f rects[GLYPH_METRICS_CAPACITY];
+    Vec4f uvs[GLYPH_METRICS_CAPACITY];
+    for (size_t i = 0; i < GLYPH_METRICS_CAPACITY; ++i)
+    {
+        Glyph_Metric metric = atlas->metrics[i];
+        rects[i] = vec4f(metric.bl, metric.bt, metric.bw, metric.bh);
+        uvs[i] = vec4f(metric.tx, 0.0f, metric.bw / (float)atlas->atlas_width, metric.bh / (float)atlas->atlas_height);
     }
+    simple_renderer_set_glyph_metrics(sr, rects, uvs, GLYPH_METRICS_CAPACITY);
 }
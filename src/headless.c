@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "headless.h"
+#include "replay.h"
+#include "shortcuts.h"
+#include "allocs.h"
+#include "buffers.h"
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static bool headless_create_context(void)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "ERROR: Could not initialize EGL display: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "ERROR: Could not bind OpenGL API: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    // No config and no surface, everything is drawn into our own framebuffer
+    EGLContext context = eglCreateContext(display, (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "ERROR: Could not create EGL context: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "ERROR: Could not make EGL context current: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    return true;
+}
+#else
+static bool headless_create_context(void)
+{
+    fprintf(stderr, "ERROR: Headless mode is only supported on Linux\n");
+    return false;
+}
+#endif // __linux__
+
+bool headless_init(void)
+{
+    return headless_create_context();
+}
+
+static GLuint headless_create_framebuffer(int width, int height)
+{
+    GLuint fbo = 0;
+    GLuint rbo = 0;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenRenderbuffers(1, &rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glDeleteRenderbuffers(1, &rbo);
+        glDeleteFramebuffers(1, &fbo);
+        return 0;
+    }
+    return fbo;
+}
+
+// Roughly what a person does with the editor: keeps scrolling down through the file
+// and every now and then types something.
+static void headless_script_editor(Editor *editor, size_t frame)
+{
+    static const char typing[] = "// typing in headless mode\n";
+
+    if (editor_cursor_row(editor) + 1 >= editor->lines.count) {
+        editor_move_to_begin(editor);
+    } else {
+        editor_move_line_down(editor);
+    }
+
+    if (frame % 4 == 0) {
+        editor_insert_char(editor, typing[(frame / 4) % (sizeof(typing) - 1)]);
+        editor->last_stroke = SDL_GetTicks();
+    }
+}
+
+static void headless_script_file_browser(File_Browser *fb, size_t frame)
+{
+    if (fb->files.count > 0) fb->cursor = frame % fb->files.count;
+}
+
+// Binary PPM, so the frames can be compared against golden images without any extra dependencies
+static Errno headless_dump_frame(Simple_Renderer *sr, const char *file_path)
+{
+    size_t width = (size_t)sr->framebuffer.x;
+    size_t height = (size_t)sr->framebuffer.y;
+    uint8_t *pixels = malloc(width * height * 4);
+    assert(pixels != NULL && "Buy more RAM lol");
+    simple_renderer_read_pixels(sr, pixels);
+
+    Errno result = 0;
+    FILE *f = fopen(file_path, "wb");
+    if (f == NULL) return_defer(errno);
+
+    fprintf(f, "P6\n%zu %zu\n255\n", width, height);
+    for (size_t i = 0; i < width * height; ++i) {
+        fwrite(pixels + i * 4, 1, 3, f);
+    }
+    if (ferror(f)) return_defer(errno);
+
+defer:
+    if (f) fclose(f);
+    free(pixels);
+    return result;
+}
+
+int headless_run(const Headless_Config *config, File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
+{
+    if (sr->backend == SIMPLE_BACKEND_GL) {
+        GLuint fbo = headless_create_framebuffer(config->width, config->height);
+        if (fbo == 0) {
+            fprintf(stderr, "ERROR: Could not create %dx%d offscreen framebuffer\n", config->width, config->height);
+            return 1;
+        }
+    }
+    simple_renderer_resize(sr, config->width, config->height);
+
+    const double counter_freq = (double)SDL_GetPerformanceFrequency();
+    double total_cpu_ms = 0.0;
+    double total_gl_ms = 0.0;
+    double max_cpu_ms = 0.0;
+    double max_gl_ms = 0.0;
+    size_t total_verticies = 0;
+    size_t total_bytes = 0;
+
+    // A replay drives the input instead of the script and runs for as long as the recording
+    bool file_browser = config->file_browser;
+    size_t frames = config->frames;
+    if (replay_playing()) frames = replay_last_frame() + 1;
+
+    printf("%6s %10s %10s %10s %8s %6s %10s\n", "frame", "cpu_ms", "gl_ms", "verticies", "quads", "draws", "bytes");
+    for (size_t frame = 0; frame < frames; ++frame) {
+        frame_reset();
+        ALLOCS_FRAME_BEGIN();
+
+        // The scripts change something on every frame
+        bool input = !replay_playing();
+        if (replay_playing()) {
+            SDL_Event event;
+            Errno err;
+            while (replay_poll_event(frame, &event)) {
+                input = true;
+                if (event.type == SDL_KEYDOWN) {
+                    shortcuts_handle_keydown(&event, &file_browser, buffers_current(), fb, sr, atlas, &err);
+                } else {
+                    shortcuts_handle_textinput(&event, &file_browser, buffers_current());
+                }
+            }
+        } else if (file_browser) {
+            headless_script_file_browser(fb, frame);
+        } else {
+            headless_script_editor(buffers_current(), frame);
+        }
+
+        memset(&sr->stats, 0, sizeof(sr->stats));
+
+        const Uint64 start = SDL_GetPerformanceCounter();
+
+        finder_update();
+        simple_renderer_clear(sr, hex_to_vec4f(0x24273aFF));
+
+        if (file_browser) {
+            fb_render(fb, atlas, sr);
+        } else {
+            buffers_render(sr, atlas);
+        }
+        finder_render(sr, atlas);
+
+        const Uint64 submitted = SDL_GetPerformanceCounter();
+        // NOTE: GL timer queries are useless on llvmpipe, which only timestamps the commands
+        // as they are queued and rasterizes later. So the GL time is how long we wait for the
+        // frame to finish after submitting it, which is also what the swap would block on.
+        // The software backend is done by the time the draw returns.
+        if (sr->backend == SIMPLE_BACKEND_GL) glFinish();
+        const Uint64 finished = SDL_GetPerformanceCounter();
+        replay_frame_presented();
+        const double cpu_ms = (double)(submitted - start) * 1000.0 / counter_freq;
+        const double gl_ms = (double)(finished - submitted) * 1000.0 / counter_freq;
+
+        // Every quad is expanded into 4 verticies by the vertex shader
+        const size_t verticies = sr->stats.verticies + sr->stats.quads * 4;
+
+        printf("%6zu %10.3f %10.3f %10zu %8zu %6zu %10zu\n",
+               frame, cpu_ms, gl_ms, verticies, sr->stats.quads, sr->stats.draw_calls, sr->stats.bytes_uploaded);
+
+        total_cpu_ms += cpu_ms;
+        total_gl_ms += gl_ms;
+        if (cpu_ms > max_cpu_ms) max_cpu_ms = cpu_ms;
+        if (gl_ms > max_gl_ms) max_gl_ms = gl_ms;
+        total_verticies += verticies;
+        total_bytes += sr->stats.bytes_uploaded;
+        ALLOCS_FRAME_END(input);
+    }
+
+    if (frames > 0) {
+        const double n = (double)frames;
+        printf("avg cpu %.3f ms (max %.3f), avg gl %.3f ms (max %.3f), avg %.0f verticies, avg %.0f bytes uploaded per frame\n",
+               total_cpu_ms / n, max_cpu_ms, total_gl_ms / n, max_gl_ms, (double)total_verticies / n, (double)total_bytes / n);
+    }
+    ALLOCS_REPORT();
+
+    if (config->dump_path != NULL) {
+        Errno err = headless_dump_frame(sr, config->dump_path);
+        if (err != 0) {
+            fprintf(stderr, "ERROR: Could not save the frame to %s: %s\n", config->dump_path, strerror(err));
+            return 1;
+        }
+    }
+
+    return 0;
+}
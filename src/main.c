@@ -22,6 +22,14 @@
 #include "lexer.h"
 #include "sv.h"
 #include "shortcuts.h"
+#include "headless.h"
+#include "simple_software.h"
+#include "profiler.h"
+#include "trace.h"
+#include "replay.h"
+#include "finder.h"
+#include "buffers.h"
+#include "allocs.h"
 
 // TODO: Save file dialog
 // Needed when ded is ran without any file so it does not know where to save.
@@ -49,7 +57,6 @@ void MessageCallback(GLenum source,
 
 static Free_Glyph_Atlas atlas = {0};
 static Simple_Renderer sr = {0};
-static Editor editor = {0};
 static File_Browser fb = {0};
 
 // TODO: display errors reported via flash_error right in the text editor window somehow
@@ -59,9 +66,203 @@ static File_Browser fb = {0};
         fprintf(stderr, "\n");        \
     } while (0)
 
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--software] [--headless] [--frames <count>] [--browser] [--dump <file.ppm>] [--record <file> | --replay <file>] [--low-latency] [--buffer-budget <MB>] [--no-session] [file]\n", program);
+    fprintf(stderr, "    --software            render on the CPU instead of OpenGL\n");
+    fprintf(stderr, "    --headless            render offscreen without a window and print frame timings\n");
+    fprintf(stderr, "    --frames <count>      how many frames to render in headless mode (default %d)\n", HEADLESS_DEFAULT_FRAMES);
+    fprintf(stderr, "    --browser             render the file browser instead of the editor in headless mode\n");
+    fprintf(stderr, "    --dump <file.ppm>     save the last frame of the headless mode as an image\n");
+    fprintf(stderr, "    --record <file>       save the keyboard input of the session\n");
+    fprintf(stderr, "    --replay <file>       play a recorded session back and print its keystroke to present latency\n");
+    fprintf(stderr, "    --low-latency         poll the input right before the next refresh instead of right after the last one\n");
+    fprintf(stderr, "    --buffer-budget <MB>  memory for the tokens of the files in the background before they are dropped (default %d)\n", BUFFERS_DEFAULT_BUDGET_MB);
+    fprintf(stderr, "    --no-session          do not reopen the files of the last run in this directory or remember them for the next one\n");
+}
+
+static bool is_navigation_key(SDL_Keycode sym)
+{
+    switch (sym) {
+        case SDLK_UP:
+        case SDLK_DOWN:
+        case SDLK_LEFT:
+        case SDLK_RIGHT:
+        case SDLK_PAGEUP:
+        case SDLK_PAGEDOWN:
+        case SDLK_HOME:
+        case SDLK_END:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Key repeats pile up while a frame takes longer than the repeat interval, and the cursor
+// would keep on going after the key is released. Only the first repeat of a navigation key
+// in a frame is handled, `repeated` remembers it until the next frame.
+static bool coalesce_key_repeat(const SDL_Event *event, SDL_Keysym *repeated)
+{
+    if (event->type != SDL_KEYDOWN || !event->key.repeat || !is_navigation_key(event->key.keysym.sym)) return false;
+    if (repeated->sym == event->key.keysym.sym && repeated->mod == event->key.keysym.mod) return true;
+    *repeated = event->key.keysym;
+    return false;
+}
+
+#define PACER_HISTORY 8
+// Slack for the scheduler waking up late and for the swap itself
+#define PACER_MARGIN_MS 1.5
+
+// Paces the low latency mode. Instead of sleeping off the rest of the frame after presenting,
+// it sleeps before polling, until the latest moment that still leaves enough time to render
+// and present by the next refresh. So the input is latched as late as possible.
+typedef struct
+{
+    Uint64 period;             // of the display refresh, in performance counter ticks
+    Uint64 work[PACER_HISTORY]; // from polling to having the frame ready to swap in the recent frames
+    size_t work_next;
+    Uint64 next_present;
+    Uint64 latched;
+} Frame_Pacer;
+
+static void pacer_init(Frame_Pacer *pacer, SDL_Window *window)
+{
+    int refresh_rate = FPS;
+    SDL_DisplayMode mode;
+    if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0) refresh_rate = mode.refresh_rate;
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->period = SDL_GetPerformanceFrequency() / refresh_rate;
+}
+
+// Sleeps until it is time to poll and measures the time since the last poll for the animations
+static void pacer_latch(Frame_Pacer *pacer, Simple_Renderer *sr)
+{
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    if (pacer->next_present != 0) {
+        Uint64 work = 0;
+        for (size_t i = 0; i < PACER_HISTORY; ++i) {
+            if (pacer->work[i] > work) work = pacer->work[i];
+        }
+        Uint64 margin = (Uint64)(PACER_MARGIN_MS * freq / 1000.0);
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now + work + margin < pacer->next_present) {
+            SDL_Delay((Uint32)((double)(pacer->next_present - work - margin - now) * 1000.0 / freq));
+        }
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (pacer->latched != 0) {
+        float dt = (float)((double)(now - pacer->latched) / freq);
+        // Hitches such as dragging the window around should not throw the camera off
+        sr->delta_time = dt < 0.1f ? dt : 0.1f;
+    }
+    pacer->latched = now;
+}
+
+// Right before the swap, which blocks until the refresh with vsync and would be counted as work
+static void pacer_rendered(Frame_Pacer *pacer)
+{
+    pacer->work[pacer->work_next] = SDL_GetPerformanceCounter() - pacer->latched;
+    pacer->work_next = (pacer->work_next + 1) % PACER_HISTORY;
+}
+
+static void pacer_presented(Frame_Pacer *pacer)
+{
+    // With vsync the swap returns at a refresh, otherwise this keeps the same cadence
+    pacer->next_present = SDL_GetPerformanceCounter() + pacer->period;
+}
+
+static void handle_event(SDL_Event *event, bool *quit, bool *file_browser)
+{
+    Errno err;
+    switch (event->type) {
+        case SDL_QUIT:
+            *quit = true;
+            break;
+
+        case SDL_KEYDOWN:
+            shortcuts_handle_keydown(event, file_browser, buffers_current(), &fb, &sr, &atlas, &err);
+            break;
+
+        case SDL_TEXTINPUT:
+            shortcuts_handle_textinput(event, file_browser, buffers_current());
+            break;
+    }
+}
+
+static void present_software_frame(SDL_Window *window, Simple_Renderer *sr)
+{
+    SDL_Surface *window_surface = SDL_GetWindowSurface(window);
+    if (window_surface == NULL) return;
+
+    // Wraps the pixels of the renderer, only made again when they move after a resize
+    static SDL_Surface *frame = NULL;
+    int w = (int)sr->framebuffer.x;
+    int h = (int)sr->framebuffer.y;
+    void *pixels = (void *)simple_software_pixels(sr->software);
+    if (frame == NULL || frame->pixels != pixels || frame->w != w || frame->h != h) {
+        SDL_FreeSurface(frame);
+        frame = SDL_CreateRGBSurfaceWithFormatFrom(pixels, w, h, 32, w * 4, SDL_PIXELFORMAT_RGBA32);
+        if (frame == NULL) return;
+    }
+
+    SDL_BlitSurface(frame, NULL, window_surface, NULL);
+    SDL_UpdateWindowSurface(window);
+}
+
 int main(int argc, char **argv)
 {
     Errno err;
+
+    const char *file_path = NULL;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    bool headless = false;
+    bool low_latency = false;
+    size_t buffer_budget_mb = BUFFERS_DEFAULT_BUDGET_MB;
+    bool session = true;
+    Headless_Config headless_config = {
+        .frames = HEADLESS_DEFAULT_FRAMES,
+        .width = SCREEN_WIDTH,
+        .height = SCREEN_HEIGHT,
+    };
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--software") == 0) {
+            sr.backend = SIMPLE_BACKEND_SOFTWARE;
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            headless_config.dump_path = argv[++i];
+        } else if (strcmp(argv[i], "--browser") == 0) {
+            headless_config.file_browser = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            headless_config.frames = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--low-latency") == 0) {
+            low_latency = true;
+        } else if (strcmp(argv[i], "--buffer-budget") == 0 && i + 1 < argc) {
+            buffer_budget_mb = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--no-session") == 0) {
+            session = false;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            file_path = argv[i];
+        }
+    }
+    if (record_path != NULL && (replay_path != NULL || headless)) {
+        fprintf(stderr, "ERROR: Only the input of a user can be recorded\n");
+        usage(argv[0]);
+        return 1;
+    }
+    // The headless mode and the recordings start out with nothing but the file they are given
+    if (headless || record_path != NULL || replay_path != NULL) session = false;
+
     FT_Library library = {0};
 
     FT_Error error = FT_Init_FreeType(&library);
@@ -91,15 +292,43 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    if (argc > 1) {
-        const char *file_path = argv[1];
-        err = editor_load_from_file(&editor, file_path);
+    // The tokens are positioned with the metrics of the atlas, so it has to be there before any
+    // file is lexed
+    free_glyph_atlas_init(&atlas, face, font_file_path);
+
+    buffers_init(&atlas);
+    buffers_set_budget(buffer_budget_mb * 1024 * 1024);
+    if (session) {
+        err = buffers_restore_session(&sr);
+        if (err != 0 && err != ENOENT) {
+            fprintf(stderr, "WARNING: Could not restore the last session: %s\n", strerror(err));
+        }
+    }
+    if (file_path != NULL) {
+        err = buffers_open(file_path, &sr);
         if (err != 0) {
             fprintf(stderr, "ERROR: Could not read file %s: %s\n", file_path, strerror(err));
             return 1;
         }
     }
 
+    const Editor *editor = buffers_current();
+    if (record_path != NULL) {
+        err = replay_record_begin(record_path, editor->data.items, editor->data.count);
+        if (err != 0) {
+            fprintf(stderr, "ERROR: Could not start recording into %s: %s\n", record_path, strerror(err));
+            return 1;
+        }
+    }
+
+    if (replay_path != NULL) {
+        err = replay_load(replay_path, editor->data.items, editor->data.count);
+        if (err != 0) {
+            fprintf(stderr, "ERROR: Could not load recording %s: %s\n", replay_path, strerror(err));
+            return 1;
+        }
+    }
+
     const char *dir_path = ".";
     err = fb_open_dir(&fb, dir_path);
     if (err != 0) {
@@ -107,120 +336,194 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "ERROR: Could not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
+    SDL_Window *window = NULL;
+    if (headless) {
+        if (sr.backend == SIMPLE_BACKEND_GL && !headless_init()) return 1;
+    } else {
+        if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+            fprintf(stderr, "ERROR: Could not initialize SDL: %s\n", SDL_GetError());
+            return 1;
+        }
 
-    SDL_Window *window =
-        SDL_CreateWindow("detey",
-                         0, 0,
-                         SCREEN_WIDTH, SCREEN_HEIGHT,
-                         SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL);
-    if (window == NULL) {
-        fprintf(stderr, "ERROR: Could not create SDL window: %s\n", SDL_GetError());
-        return 1;
-    }
+        Uint32 window_flags = SDL_WINDOW_RESIZABLE;
+        if (sr.backend == SIMPLE_BACKEND_GL) window_flags |= SDL_WINDOW_OPENGL;
+        window =
+            SDL_CreateWindow("detey",
+                             0, 0,
+                             SCREEN_WIDTH, SCREEN_HEIGHT,
+                             window_flags);
+        if (window == NULL) {
+            fprintf(stderr, "ERROR: Could not create SDL window: %s\n", SDL_GetError());
+            return 1;
+        }
 
-    {
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        if (sr.backend == SIMPLE_BACKEND_GL) {
+            {
+                SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+                SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+                SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+                int major;
+                int minor;
+                SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &major);
+                SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &minor);
+                printf("GL version %d.%d\n", major, minor);
+            }
 
-        int major;
-        int minor;
-        SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &major);
-        SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &minor);
-        printf("GL version %d.%d\n", major, minor);
-    }
+            if (SDL_GL_CreateContext(window) == NULL) {
+                fprintf(stderr, "ERROR: Could not create OpenGL context: %s\n", SDL_GetError());
+                return 1;
+            }
 
-    if (SDL_GL_CreateContext(window) == NULL) {
-        fprintf(stderr, "ERROR: Could not create OpenGL context: %s\n", SDL_GetError());
-        return 1;
+            // Adaptive sync shows a late frame right away instead of holding it for another refresh
+            if (low_latency && SDL_GL_SetSwapInterval(-1) < 0 && SDL_GL_SetSwapInterval(1) < 0) {
+                fprintf(stderr, "WARNING: Could not enable vsync: %s\n", SDL_GetError());
+            }
+        }
     }
 
-    GLenum glewErr = glewInit();
-    if (GLEW_OK != glewErr) {
-        fprintf(stderr, "ERROR: Could not initialize GLEW: %s\n", glewGetErrorString(glewErr));
-        return 1;
-    }
+    if (sr.backend == SIMPLE_BACKEND_GL) {
+        GLenum glewErr = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        // The EGL context of the headless mode has no GLX display, but the GL functions are loaded anyway
+        if (headless && glewErr == GLEW_ERROR_NO_GLX_DISPLAY) glewErr = GLEW_OK;
+#endif
+        if (GLEW_OK != glewErr) {
+            fprintf(stderr, "ERROR: Could not initialize GLEW: %s\n", glewGetErrorString(glewErr));
+            return 1;
+        }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    if (GLEW_ARB_debug_output) {
-        glEnable(GL_DEBUG_OUTPUT);
-        glDebugMessageCallback(MessageCallback, 0);
-    }
-    else {
-        fprintf(stderr, "WARNING: GLEW_ARB_debug_output is not available");
+        if (GLEW_ARB_debug_output) {
+            glEnable(GL_DEBUG_OUTPUT);
+            glDebugMessageCallback(MessageCallback, 0);
+        }
+        else {
+            fprintf(stderr, "WARNING: GLEW_ARB_debug_output is not available");
+        }
     }
 
     simple_renderer_init(&sr);
-    free_glyph_atlas_init(&atlas, face);
+    free_glyph_atlas_bind(&atlas, &sr);
+
+    if (headless) {
+        int status = headless_run(&headless_config, &fb, &atlas, &sr);
+        if (replay_playing()) replay_report();
+        TRACE_DUMP();
+        return status;
+    }
 
-    editor.atlas = &atlas;
-    editor_retokenize(&editor);
+    // By the time anybody hits Ctrl+P most of the tree is likely indexed already
+    finder_start_indexing();
 
     bool quit = false;
     bool file_browser = false;
+    size_t frame = 0;
+    Frame_Pacer pacer;
+    pacer_init(&pacer, window);
     while (!quit) {
+        frame_reset();
+        ALLOCS_FRAME_BEGIN();
+        if (low_latency) pacer_latch(&pacer, &sr);
+
         const Uint32 start = SDL_GetTicks();
+        memset(&sr.stats, 0, sizeof(sr.stats));
+        profiler_frame_begin(&sr);
+
+        profiler_begin(PROFILER_STAGE_EVENTS);
         SDL_Event event = {0};
+        SDL_Keysym repeated = {0};
+        bool input = false;
         while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    quit = true;
-                    break;
-
-                case SDL_KEYDOWN:
-                    shortcuts_handle_keydown(&event, &file_browser, &editor, &fb, &sr, &atlas, &err);
-                    break;
-
-                case SDL_TEXTINPUT:
-                    if (file_browser) {
-                        // Nothing for now
-                    }
-                    else {
-                        const char *text = event.text.text;
-                        size_t text_len = strlen(text);
-                        for (size_t i = 0; i < text_len; ++i) {
-                            editor_insert_char(&editor, text[i]);
-                        }
-                        editor.last_stroke = SDL_GetTicks();
-                    }
-                    break;
-            }
+            input = true;
+            // Typing into a replay would make it diverge from the recording
+            if (replay_playing() && event.type != SDL_QUIT) continue;
+            replay_record_event(&event, frame);
+            if (low_latency && coalesce_key_repeat(&event, &repeated)) continue;
+            replay_track_event(&event);
+            handle_event(&event, &quit, &file_browser);
+        }
+        while (replay_poll_event(frame, &event)) {
+            input = true;
+            if (low_latency && coalesce_key_repeat(&event, &repeated)) continue;
+            handle_event(&event, &quit, &file_browser);
         }
 
         {
             int w, h;
             SDL_GetWindowSize(window, &w, &h);
-            // TODO(#19): update the viewport and the resolution only on actual window change
-            glViewport(0, 0, w, h);
-            sr.resolution.x = (float)w;
-            sr.resolution.y = (float)h;
+            if ((float)w != sr.framebuffer.x || (float)h != sr.framebuffer.y) {
+                simple_renderer_resize(&sr, w, h);
+            }
         }
 
-        Vec4f bg = hex_to_vec4f(0x24273aFF);
-        glClearColor(bg.x, bg.y, bg.z, bg.w);
-        glClear(GL_COLOR_BUFFER_BIT);
+        fb_poll_changes(&fb);
+        buffers_poll_changes();
+        finder_update();
+        profiler_end(PROFILER_STAGE_EVENTS);
+
+        profiler_begin(PROFILER_STAGE_GENERATE);
+        simple_renderer_clear(&sr, hex_to_vec4f(0x24273aFF));
 
         if (file_browser) {
-            fb_render(&fb, window, &atlas, &sr);
+            fb_render(&fb, &atlas, &sr);
         }
         else {
-            editor_render(window, &atlas, &sr, &editor);
+            buffers_render(&sr, &atlas);
         }
+        finder_render(&sr, &atlas);
+        profiler_end(PROFILER_STAGE_GENERATE);
 
-        SDL_GL_SwapWindow(window);
+        profiler_render(&sr, &atlas);
 
-        const Uint32 duration = SDL_GetTicks() - start;
-        const Uint32 delta_time_ms = 1000 / FPS;
-        if (duration < delta_time_ms) {
-            SDL_Delay(delta_time_ms - duration);
+        if (low_latency) {
+            // The GPU has to be done as well, otherwise the swap waits for it past the refresh
+            if (sr.backend == SIMPLE_BACKEND_GL) glFinish();
+            pacer_rendered(&pacer);
         }
+
+        profiler_begin(PROFILER_STAGE_SWAP);
+        if (sr.backend == SIMPLE_BACKEND_SOFTWARE) {
+            present_software_frame(window, &sr);
+        } else {
+            SDL_GL_SwapWindow(window);
+        }
+        profiler_end(PROFILER_STAGE_SWAP);
+        replay_frame_presented();
+
+        profiler_frame_end(&sr);
+        ALLOCS_FRAME_END(input);
+
+        if (low_latency) {
+            pacer_presented(&pacer);
+        } else {
+            const Uint32 duration = SDL_GetTicks() - start;
+            const Uint32 delta_time_ms = 1000 / FPS;
+            if (duration < delta_time_ms) {
+                SDL_Delay(delta_time_ms - duration);
+            }
+        }
+
+        if (replay_playing() && frame >= replay_last_frame()) quit = true;
+        frame += 1;
+    }
+
+    if (session) {
+        err = buffers_save_session();
+        if (err != 0) {
+            fprintf(stderr, "WARNING: Could not save the session: %s\n", strerror(err));
+        }
+    }
+
+    replay_report();
+    ALLOCS_REPORT();
+    err = replay_record_end();
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not save the recording into %s: %s\n", record_path, strerror(err));
     }
+    TRACE_DUMP();
     return 0;
 }
 
@@ -0,0 +1,280 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "profiler.h"
+#include "common.h"
+
+#define PROFILER_STACK_CAP 8
+// Timer query results are picked up this many frames later. A result that is still not there
+// by then is not waited for, that frame goes without the GPU time instead.
+#define PROFILER_QUERIES_CAP 4
+
+// The overlay is laid out in screen pixels, the text is the atlas scaled down to this
+#define OVERLAY_SCALE 0.25f
+#define OVERLAY_PADDING 8.0f
+#define OVERLAY_WIDTH (PROFILER_HISTORY_CAP * 2.0f)
+#define OVERLAY_GRAPH_HEIGHT 120.0f
+#define OVERLAY_GRAPH_MS 33.3f
+#define OVERLAY_LINE_HEIGHT (FREE_GLYPH_FONT_SIZE * OVERLAY_SCALE * 1.2f)
+
+static const char *stage_names[COUNT_PROFILER_STAGES] = {
+    [PROFILER_STAGE_EVENTS] = "events",
+    [PROFILER_STAGE_RETOKENIZE] = "retokenize",
+    [PROFILER_STAGE_GENERATE] = "generate",
+    [PROFILER_STAGE_SYNC] = "sync",
+    [PROFILER_STAGE_DRAW] = "draw",
+    [PROFILER_STAGE_SWAP] = "swap",
+};
+
+static const uint32_t stage_colors[COUNT_PROFILER_STAGES] = {
+    [PROFILER_STAGE_EVENTS] = 0x8aadf4ff,
+    [PROFILER_STAGE_RETOKENIZE] = 0xc6a0f6ff,
+    [PROFILER_STAGE_GENERATE] = 0xa6da95ff,
+    [PROFILER_STAGE_SYNC] = 0xeed49fff,
+    [PROFILER_STAGE_DRAW] = 0xf5a97fff,
+    [PROFILER_STAGE_SWAP] = 0x6e738dff,
+};
+
+static struct
+{
+    bool enabled;
+    bool requested;
+
+    Uint64 mark;
+    Profiler_Stage stack[PROFILER_STACK_CAP];
+    size_t depth;
+
+    Profiler_Frame current;
+    Profiler_Frame history[PROFILER_HISTORY_CAP];
+    size_t history_count;
+    size_t history_next;
+
+    bool gpu_timing;
+    bool query_started; // for the frame in flight
+    GLuint queries[PROFILER_QUERIES_CAP];
+    bool query_pending[PROFILER_QUERIES_CAP];
+    size_t query_frame[PROFILER_QUERIES_CAP]; // history slot the query result belongs to
+    size_t query_next;
+} profiler = {0};
+
+void profiler_toggle(void)
+{
+    profiler.requested = !profiler.requested;
+}
+
+bool profiler_enabled(void)
+{
+    return profiler.enabled;
+}
+
+static float profiler_ms(Uint64 ticks)
+{
+    return (float)((double)ticks * 1000.0 / (double)SDL_GetPerformanceFrequency());
+}
+
+void profiler_begin(Profiler_Stage stage)
+{
+    if (!profiler.enabled) return;
+    assert(profiler.depth < PROFILER_STACK_CAP);
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (profiler.depth > 0)
+    {
+        profiler.current.stage_ms[profiler.stack[profiler.depth - 1]] += profiler_ms(now - profiler.mark);
+    }
+    profiler.stack[profiler.depth++] = stage;
+    profiler.mark = now;
+}
+
+void profiler_end(Profiler_Stage stage)
+{
+    if (!profiler.enabled) return;
+    assert(profiler.depth > 0 && profiler.stack[profiler.depth - 1] == stage);
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    profiler.current.stage_ms[stage] += profiler_ms(now - profiler.mark);
+    profiler.depth -= 1;
+    profiler.mark = now;
+}
+
+void profiler_frame_begin(Simple_Renderer *sr)
+{
+    if (profiler.enabled != profiler.requested)
+    {
+        profiler.enabled = profiler.requested;
+        memset(profiler.query_pending, 0, sizeof(profiler.query_pending));
+        profiler.history_count = 0;
+        profiler.history_next = 0;
+    }
+    if (!profiler.enabled) return;
+
+    memset(&profiler.current, 0, sizeof(profiler.current));
+    profiler.current.gpu_ms = -1.0f;
+    profiler.depth = 0;
+
+    profiler.gpu_timing = sr->backend == SIMPLE_BACKEND_GL;
+    if (profiler.gpu_timing)
+    {
+        if (profiler.queries[0] == 0) glGenQueries(PROFILER_QUERIES_CAP, profiler.queries);
+
+        size_t slot = profiler.query_next;
+        if (profiler.query_pending[slot])
+        {
+            // Asking for GL_QUERY_RESULT right away would block until the GPU catches up,
+            // which is exactly the kind of hitch the profiler is there to show
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(profiler.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(profiler.queries[slot], GL_QUERY_RESULT, &ns);
+                profiler.history[profiler.query_frame[slot]].gpu_ms = (float)((double)ns / 1000000.0);
+                profiler.query_pending[slot] = false;
+            }
+        }
+
+        // The query of the slot is still in use, this frame is not timed on the GPU
+        profiler.query_started = !profiler.query_pending[slot];
+        if (profiler.query_started) glBeginQuery(GL_TIME_ELAPSED, profiler.queries[slot]);
+    }
+}
+
+void profiler_frame_end(Simple_Renderer *sr)
+{
+    if (!profiler.enabled) return;
+    assert(profiler.depth == 0 && "Unbalanced profiler stages");
+
+    if (profiler.gpu_timing && profiler.query_started)
+    {
+        size_t slot = profiler.query_next;
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler.query_pending[slot] = true;
+        profiler.query_frame[slot] = profiler.history_next;
+        profiler.query_next = (slot + 1) % PROFILER_QUERIES_CAP;
+    }
+
+    profiler.current.stats = sr->stats;
+    profiler.history[profiler.history_next] = profiler.current;
+    profiler.history_next = (profiler.history_next + 1) % PROFILER_HISTORY_CAP;
+    if (profiler.history_count < PROFILER_HISTORY_CAP) profiler.history_count += 1;
+}
+
+static void overlay_text(Simple_Renderer *sr, Free_Glyph_Atlas *atlas, float x, float y, const char *text, Vec4f color)
+{
+    Vec2f pen = simple_renderer_overlay_point(sr, x, y + OVERLAY_LINE_HEIGHT * 0.75f);
+    free_glyph_atlas_render_line_sized(atlas, sr, text, strlen(text), &pen, color);
+}
+
+static const Profiler_Frame *profiler_frame_ago(size_t ago)
+{
+    assert(ago < profiler.history_count);
+    return &profiler.history[(profiler.history_next + PROFILER_HISTORY_CAP - 1 - ago) % PROFILER_HISTORY_CAP];
+}
+
+void profiler_render(Simple_Renderer *sr, Free_Glyph_Atlas *atlas)
+{
+    if (!profiler.enabled || profiler.history_count == 0) return;
+
+    // The overlay is not what is being profiled
+    profiler.enabled = false;
+
+    Simple_Renderer_Stats stats = sr->stats;
+    simple_renderer_begin_overlay(sr, OVERLAY_SCALE);
+
+    const float x = OVERLAY_PADDING;
+    float y = OVERLAY_PADDING;
+    const size_t lines = COUNT_PROFILER_STAGES + 3;
+    const float height = OVERLAY_GRAPH_HEIGHT + lines * OVERLAY_LINE_HEIGHT + 3 * OVERLAY_PADDING;
+
+    simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+    simple_renderer_overlay_rect(sr, x, y, OVERLAY_WIDTH + 2 * OVERLAY_PADDING, height, hex_to_vec4f(0x181926d0));
+
+    // Stacked stage timings, the latest frame on the right
+    {
+        const float graph_y = y + OVERLAY_PADDING;
+        const float bar_width = OVERLAY_WIDTH / PROFILER_HISTORY_CAP;
+        const float px_per_ms = OVERLAY_GRAPH_HEIGHT / OVERLAY_GRAPH_MS;
+        for (size_t ago = 0; ago < profiler.history_count; ++ago)
+        {
+            const Profiler_Frame *frame = profiler_frame_ago(ago);
+            float bar_x = x + OVERLAY_PADDING + OVERLAY_WIDTH - (float)(ago + 1) * bar_width;
+            float bottom = graph_y + OVERLAY_GRAPH_HEIGHT;
+            for (size_t stage = 0; stage < COUNT_PROFILER_STAGES; ++stage)
+            {
+                float h = frame->stage_ms[stage] * px_per_ms;
+                if (bottom - h < graph_y) h = bottom - graph_y;
+                if (h <= 0.0f) continue;
+                simple_renderer_overlay_rect(sr, bar_x, bottom - h, bar_width, h, hex_to_vec4f(stage_colors[stage]));
+                bottom -= h;
+            }
+        }
+
+        // The budget of a single frame
+        float budget_y = graph_y + OVERLAY_GRAPH_HEIGHT - px_per_ms * 1000.0f / FPS;
+        simple_renderer_overlay_rect(sr, x + OVERLAY_PADDING, budget_y, OVERLAY_WIDTH, 1.0f, hex_to_vec4f(0xed8796ff));
+        y = graph_y + OVERLAY_GRAPH_HEIGHT + OVERLAY_PADDING;
+    }
+
+    simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+    {
+        char line[128];
+        const Vec4f header_color = hex_to_vec4f(0xcad3f5ff);
+        const size_t n = profiler.history_count;
+
+        snprintf(line, sizeof(line), "%-10s %7s %7s %7s", "ms", "last", "avg", "max");
+        overlay_text(sr, atlas, x + OVERLAY_PADDING, y, line, header_color);
+        y += OVERLAY_LINE_HEIGHT;
+
+        for (size_t stage = 0; stage < COUNT_PROFILER_STAGES; ++stage)
+        {
+            float sum = 0.0f;
+            float max = 0.0f;
+            for (size_t ago = 0; ago < n; ++ago)
+            {
+                float ms = profiler_frame_ago(ago)->stage_ms[stage];
+                sum += ms;
+                if (ms > max) max = ms;
+            }
+            snprintf(line, sizeof(line), "%-10s %7.2f %7.2f %7.2f",
+                     stage_names[stage], profiler_frame_ago(0)->stage_ms[stage], sum / n, max);
+            overlay_text(sr, atlas, x + OVERLAY_PADDING, y, line, hex_to_vec4f(stage_colors[stage]));
+            y += OVERLAY_LINE_HEIGHT;
+        }
+
+        {
+            float last = -1.0f;
+            float sum = 0.0f;
+            float max = 0.0f;
+            size_t count = 0;
+            for (size_t ago = 0; ago < n; ++ago)
+            {
+                float ms = profiler_frame_ago(ago)->gpu_ms;
+                if (ms < 0.0f) continue;
+                if (last < 0.0f) last = ms;
+                sum += ms;
+                if (ms > max) max = ms;
+                count += 1;
+            }
+            if (count > 0)
+            {
+                snprintf(line, sizeof(line), "%-10s %7.2f %7.2f %7.2f", "gpu", last, sum / count, max);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "%-10s %7s %7s %7s", "gpu", "-", "-", "-");
+            }
+            overlay_text(sr, atlas, x + OVERLAY_PADDING, y, line, header_color);
+            y += OVERLAY_LINE_HEIGHT;
+        }
+
+        const Simple_Renderer_Stats *last = &profiler_frame_ago(0)->stats;
+        snprintf(line, sizeof(line), "verticies %zu  quads %zu  draws %zu  gl %zu  bytes %zu",
+                 last->verticies, last->quads, last->draw_calls, last->gl_calls, last->bytes_uploaded);
+        overlay_text(sr, atlas, x + OVERLAY_PADDING, y, line, header_color);
+    }
+
+    simple_renderer_end_overlay(sr);
+    sr->stats = stats;
+    profiler.enabled = true;
+}
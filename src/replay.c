@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "replay.h"
+
+#define REPLAY_MAGIC "DETEYREC"
+#define REPLAY_VERSION 1
+#define REPLAY_TEXT_SIZE 32
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t fps;
+    uint64_t data_size;
+    uint64_t data_hash;
+} Replay_Header;
+
+typedef struct
+{
+    uint32_t frame;
+    uint32_t type; // SDL_KEYDOWN or SDL_TEXTINPUT
+    int32_t sym;
+    int32_t scancode;
+    uint16_t mod;
+    uint8_t repeat;
+    char text[REPLAY_TEXT_SIZE];
+} Replay_Event;
+
+static_assert(sizeof(((SDL_TextInputEvent *)0)->text) == REPLAY_TEXT_SIZE, "SDL text input does not fit into the recording");
+
+typedef struct
+{
+    Replay_Event *items;
+    size_t count;
+    size_t capacity;
+} Replay_Events;
+
+typedef struct
+{
+    double *items;
+    size_t count;
+    size_t capacity;
+} Latencies;
+
+static struct
+{
+    FILE *recording;
+
+    bool playing;
+    Replay_Events events;
+    size_t next;
+
+    Uint64 polled[64]; // when the events of the current frame were polled, the rest of a huge frame goes unmeasured
+    size_t polled_count;
+    Latencies latencies; // in ms
+} replay = {0};
+
+static Replay_Header replay_header(const char *data, size_t size)
+{
+    Replay_Header header = {0};
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.fps = FPS;
+    header.data_size = size;
+    header.data_hash = hash_bytes(data, size);
+    return header;
+}
+
+Errno replay_record_begin(const char *file_path, const char *data, size_t size)
+{
+    assert(replay.recording == NULL);
+
+    Errno result = 0;
+    FILE *f = fopen(file_path, "wb");
+    if (f == NULL) return_defer(errno);
+
+    Replay_Header header = replay_header(data, size);
+    if (fwrite(&header, sizeof(header), 1, f) != 1) return_defer(errno);
+
+    replay.recording = f;
+    f = NULL;
+
+defer:
+    if (f) fclose(f);
+    return result;
+}
+
+void replay_record_event(const SDL_Event *event, size_t frame)
+{
+    if (replay.recording == NULL) return;
+
+    Replay_Event re = {0};
+    re.frame = (uint32_t)frame;
+    re.type = event->type;
+    switch (event->type) {
+    case SDL_KEYDOWN:
+        re.sym = event->key.keysym.sym;
+        re.scancode = event->key.keysym.scancode;
+        re.mod = event->key.keysym.mod;
+        re.repeat = event->key.repeat;
+        break;
+    case SDL_TEXTINPUT:
+        memcpy(re.text, event->text.text, REPLAY_TEXT_SIZE);
+        break;
+    default:
+        return;
+    }
+
+    if (fwrite(&re, sizeof(re), 1, replay.recording) != 1) {
+        fprintf(stderr, "ERROR: Could not write the recording: %s\n", strerror(errno));
+        fclose(replay.recording);
+        replay.recording = NULL;
+    }
+}
+
+Errno replay_record_end(void)
+{
+    if (replay.recording == NULL) return 0;
+
+    Errno result = 0;
+    if (fclose(replay.recording) != 0) result = errno;
+    replay.recording = NULL;
+    return result;
+}
+
+Errno replay_load(const char *file_path, const char *data, size_t size)
+{
+    Errno result = 0;
+    String_Builder file = {0};
+
+    Errno err = read_entire_file(file_path, &file);
+    if (err != 0) return_defer(err);
+
+    Replay_Header header = {0};
+    if (file.count < sizeof(header)) return_defer(EINVAL);
+    memcpy(&header, file.items, sizeof(header));
+    if (memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.version != REPLAY_VERSION) {
+        return_defer(EINVAL);
+    }
+    if ((file.count - sizeof(header)) % sizeof(Replay_Event) != 0) return_defer(EINVAL);
+
+    Replay_Header expected = replay_header(data, size);
+    if (header.data_size != expected.data_size || header.data_hash != expected.data_hash) {
+        fprintf(stderr, "WARNING: %s was recorded against a different file, the replay is not going to match\n", file_path);
+    }
+    if (header.fps != FPS) {
+        fprintf(stderr, "WARNING: %s was recorded at %u FPS, replaying at %d\n", file_path, header.fps, FPS);
+    }
+
+    size_t count = (file.count - sizeof(header)) / sizeof(Replay_Event);
+    replay.events.count = 0;
+    da_append_many(&replay.events, (Replay_Event *)(file.items + sizeof(header)), count);
+    replay.next = 0;
+    replay.playing = true;
+
+defer:
+    free(file.items);
+    return result;
+}
+
+bool replay_playing(void)
+{
+    return replay.playing;
+}
+
+size_t replay_last_frame(void)
+{
+    if (replay.events.count == 0) return 0;
+    return da_last(&replay.events).frame;
+}
+
+bool replay_poll_event(size_t frame, SDL_Event *event)
+{
+    if (!replay.playing || replay.next >= replay.events.count) return false;
+
+    const Replay_Event *re = &replay.events.items[replay.next];
+    if (re->frame > frame) return false;
+    replay.next += 1;
+
+    memset(event, 0, sizeof(*event));
+    event->type = re->type;
+    if (re->type == SDL_KEYDOWN) {
+        event->key.timestamp = SDL_GetTicks();
+        event->key.state = SDL_PRESSED;
+        event->key.repeat = re->repeat;
+        event->key.keysym.sym = re->sym;
+        event->key.keysym.scancode = re->scancode;
+        event->key.keysym.mod = re->mod;
+    } else {
+        event->text.timestamp = SDL_GetTicks();
+        memcpy(event->text.text, re->text, REPLAY_TEXT_SIZE);
+        event->text.text[REPLAY_TEXT_SIZE - 1] = '\0';
+    }
+
+    if (replay.polled_count < sizeof(replay.polled) / sizeof(replay.polled[0])) {
+        replay.polled[replay.polled_count++] = SDL_GetPerformanceCounter();
+    }
+    return true;
+}
+
+void replay_track_event(const SDL_Event *event)
+{
+    Uint32 timestamp = 0;
+    switch (event->type) {
+    case SDL_KEYDOWN: timestamp = event->key.timestamp; break;
+    case SDL_TEXTINPUT: timestamp = event->text.timestamp; break;
+    default: return;
+    }
+
+    // The timestamps are SDL_GetTicks() of when SDL got the event from the OS
+    Uint32 waited_ms = SDL_GetTicks() - timestamp;
+    Uint64 waited = (Uint64)waited_ms * SDL_GetPerformanceFrequency() / 1000;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (replay.polled_count < sizeof(replay.polled) / sizeof(replay.polled[0])) {
+        replay.polled[replay.polled_count++] = waited < now ? now - waited : 0;
+    }
+}
+
+void replay_frame_presented(void)
+{
+    if (replay.polled_count == 0) return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double freq = (double)SDL_GetPerformanceFrequency();
+    for (size_t i = 0; i < replay.polled_count; ++i) {
+        da_append(&replay.latencies, (double)(now - replay.polled[i]) * 1000.0 / freq);
+    }
+    replay.polled_count = 0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const Latencies *sorted, double p)
+{
+    size_t i = (size_t)(p / 100.0 * (double)(sorted->count - 1) + 0.5);
+    return sorted->items[i];
+}
+
+void replay_report(void)
+{
+    if (replay.latencies.count == 0) {
+        if (replay.playing) printf("latency: no events replayed\n");
+        return;
+    }
+
+    qsort(replay.latencies.items, replay.latencies.count, sizeof(double), compare_doubles);
+    printf("latency: %zu events, keystroke to present latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           replay.latencies.count,
+           percentile(&replay.latencies, 50.0),
+           percentile(&replay.latencies, 90.0),
+           percentile(&replay.latencies, 99.0),
+           da_last(&replay.latencies));
+}
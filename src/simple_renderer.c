@@ -5,9 +5,16 @@
 #include <string.h>
 #include <errno.h>
 #include "simple_renderer.h"
+#include "simple_software.h"
 #include "common.h"
+#include "profiler.h"
+#include "trace.h"
 
 #define vert_shader_file_path "./shaders/simple.vert"
+#define quad_vert_shader_file_path "./shaders/simple_quad.vert"
+#define uber_frag_shader_file_path "./shaders/simple_uber.frag"
+
+#define GLYPH_METRICS_BINDING 0
 
 static_assert(COUNT_SIMPLE_SHADERS == 4, "The amount of fragment shaders has changed");
 const char *frag_shader_file_paths[COUNT_SIMPLE_SHADERS] = {
@@ -54,25 +61,26 @@ static bool compile_shader_source(const GLchar *source, GLenum shader_type, GLui
 
 static bool compile_shader_file(const char *file_path, GLenum shader_type, GLuint *shader)
 {
-    bool result = true;
-
-    String_Builder source = {0};
-    Errno err = read_entire_file(file_path, &source);
+    // Shaders are reloaded in the middle of a frame, the source goes into the frame arena
+    const char *data = NULL;
+    size_t size = 0;
+    Errno err = map_entire_file(file_path, &data, &size);
     if (err != 0)
     {
-        fprintf(stderr, "ERROR: failed to load `%s` shader file: %s\n", file_path, strerror(errno));
-        return_defer(false);
+        fprintf(stderr, "ERROR: failed to load `%s` shader file: %s\n", file_path, strerror(err));
+        return false;
     }
-    sb_append_null(&source);
+    char *source = frame_alloc(size + 1);
+    memcpy(source, data, size);
+    source[size] = '\0';
+    unmap_entire_file(data, size);
 
-    if (!compile_shader_source(source.items, shader_type, shader))
+    if (!compile_shader_source(source, shader_type, shader))
     {
         fprintf(stderr, "ERROR: failed to compile `%s` shader file\n", file_path);
-        return_defer(false);
+        return false;
     }
-defer:
-    free(source.items);
-    return result;
+    return true;
 }
 
 static void attach_shaders_to_program(GLuint *shaders, size_t shaders_count, GLuint program)
@@ -135,9 +143,120 @@ static void get_uniform_location(GLuint program, GLint locations[COUNT_UNIFORM_S
     }
 }
 
+static void simple_program_assign(Simple_Program *program, GLuint id)
+{
+    memset(program, 0, sizeof(*program));
+    program->id = id;
+    get_uniform_location(id, program->uniforms);
+}
+
+static void simple_renderer_assign_programs(Simple_Renderer *sr, const GLuint programs[COUNT_SIMPLE_SHADERS], GLuint quad_program)
+{
+    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+    {
+        if (sr->programs[i].id != 0) glDeleteProgram(sr->programs[i].id);
+        simple_program_assign(&sr->programs[i], programs[i]);
+    }
+    if (sr->quad_program.id != 0) glDeleteProgram(sr->quad_program.id);
+    simple_program_assign(&sr->quad_program, quad_program);
+    // Program names may get reused after deletion
+    sr->bound_program = 0;
+}
+
+// Links every fragment shader against the given vertex shader
+static bool load_programs(const char *vert_file_path, GLuint programs[COUNT_SIMPLE_SHADERS])
+{
+    GLuint new_programs[COUNT_SIMPLE_SHADERS];
+    GLuint shaders[2] = {0};
+
+    bool ok = true;
+
+    if (!compile_shader_file(vert_file_path, GL_VERTEX_SHADER, &shaders[0]))
+    {
+        ok = false;
+    }
+
+    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+    {
+        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1]))
+        {
+            ok = false;
+        }
+        new_programs[i] = glCreateProgram();
+        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), new_programs[i]);
+        if (!link_program(new_programs[i], __FILE__, __LINE__))
+        {
+            ok = false;
+        }
+        glDeleteShader(shaders[1]);
+    }
+    glDeleteShader(shaders[0]);
+
+    if (!ok)
+    {
+        for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+        {
+            glDeleteProgram(new_programs[i]);
+        }
+        return false;
+    }
+
+    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+    {
+        programs[i] = new_programs[i];
+    }
+    return true;
+}
+
+static bool load_quad_program(GLuint *program)
+{
+    GLuint shaders[2] = {0};
+
+    bool ok = true;
+
+    if (!compile_shader_file(quad_vert_shader_file_path, GL_VERTEX_SHADER, &shaders[0]))
+    {
+        ok = false;
+    }
+    if (!compile_shader_file(uber_frag_shader_file_path, GL_FRAGMENT_SHADER, &shaders[1]))
+    {
+        ok = false;
+    }
+
+    GLuint new_program = glCreateProgram();
+    attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), new_program);
+    if (!link_program(new_program, __FILE__, __LINE__))
+    {
+        ok = false;
+    }
+    glDeleteShader(shaders[0]);
+    glDeleteShader(shaders[1]);
+
+    if (!ok)
+    {
+        glDeleteProgram(new_program);
+        return false;
+    }
+
+    GLuint block = glGetUniformBlockIndex(new_program, "Glyph_Metrics");
+    if (block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(new_program, block, GLYPH_METRICS_BINDING);
+    }
+    *program = new_program;
+    return true;
+}
+
 void simple_renderer_init(Simple_Renderer *sr)
 {
     sr->camera_scale = 3.0f;
+    sr->delta_time = DELTA_TIME;
+
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
+    {
+        sr->software = simple_software_create();
+        return;
+    }
 
     {
         glGenVertexArrays(1, &sr->vao);
@@ -145,7 +264,7 @@ void simple_renderer_init(Simple_Renderer *sr)
 
         glGenBuffers(1, &sr->vbo);
         glBindBuffer(GL_ARRAY_BUFFER, sr->vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(sr->verticies), sr->verticies, GL_DYNAMIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, SIMPLE_VERTICIES_RING_CAP * sizeof(Simple_Vertex), NULL, GL_STREAM_DRAW);
 
         // position
         glEnableVertexAttribArray(SIMPLE_VERTEX_ATTR_POSITION);
@@ -162,8 +281,8 @@ void simple_renderer_init(Simple_Renderer *sr)
         glVertexAttribPointer(
             SIMPLE_VERTEX_ATTR_COLOR,
             4,
-            GL_FLOAT,
-            GL_FALSE,
+            GL_UNSIGNED_BYTE,
+            GL_TRUE,
             sizeof(Simple_Vertex),
             (GLvoid *)offsetof(Simple_Vertex, color));
 
@@ -172,82 +291,259 @@ void simple_renderer_init(Simple_Renderer *sr)
         glVertexAttribPointer(
             SIMPLE_VERTEX_ATTR_UV,
             2,
-            GL_FLOAT,
-            GL_FALSE,
+            GL_UNSIGNED_SHORT,
+            GL_TRUE,
             sizeof(Simple_Vertex),
             (GLvoid *)offsetof(Simple_Vertex, uv));
     }
 
-    GLuint shaders[2] = {0};
+    {
+        glGenVertexArrays(1, &sr->quad_vao);
+        glBindVertexArray(sr->quad_vao);
+
+        glGenBuffers(1, &sr->quad_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, sr->quad_vbo);
+        glBufferData(GL_ARRAY_BUFFER, SIMPLE_QUADS_RING_CAP * sizeof(Simple_Quad), NULL, GL_STREAM_DRAW);
+
+        // The pointers themselves are set up in simple_renderer_point_quad_attribs()
+        glEnableVertexAttribArray(SIMPLE_QUAD_ATTR_POSITION);
+        glVertexAttribDivisor(SIMPLE_QUAD_ATTR_POSITION, 1);
+        glEnableVertexAttribArray(SIMPLE_QUAD_ATTR_SIZE);
+        glVertexAttribDivisor(SIMPLE_QUAD_ATTR_SIZE, 1);
+        glEnableVertexAttribArray(SIMPLE_QUAD_ATTR_COLOR);
+        glVertexAttribDivisor(SIMPLE_QUAD_ATTR_COLOR, 1);
+        glEnableVertexAttribArray(SIMPLE_QUAD_ATTR_INDEX);
+        glVertexAttribDivisor(SIMPLE_QUAD_ATTR_INDEX, 1);
+        glEnableVertexAttribArray(SIMPLE_QUAD_ATTR_SHADER);
+        glVertexAttribDivisor(SIMPLE_QUAD_ATTR_SHADER, 1);
+
+        glGenBuffers(1, &sr->glyph_metrics_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, sr->glyph_metrics_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, 2 * SIMPLE_GLYPH_METRICS_CAP * sizeof(Vec4f), NULL, GL_STATIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, GLYPH_METRICS_BINDING, sr->glyph_metrics_ubo);
+    }
+
+    GLuint programs[COUNT_SIMPLE_SHADERS] = {0};
+    GLuint quad_program = 0;
 
-    if (!compile_shader_file(vert_shader_file_path, GL_VERTEX_SHADER, &shaders[0]))
+    if (!load_programs(vert_shader_file_path, programs))
     {
         exit(1);
     }
 
-    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+    if (!load_quad_program(&quad_program))
     {
-        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1]))
-        {
-            exit(1);
-        }
-        sr->programs[i] = glCreateProgram();
-        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), sr->programs[i]);
-        if (!link_program(sr->programs[i], __FILE__, __LINE__))
+        exit(1);
+    }
+
+    simple_renderer_assign_programs(sr, programs, quad_program);
+
+    sr->bound_vao = sr->quad_vao;
+    sr->bound_array_buffer = sr->quad_vbo;
+    sr->quad_attribs_base = SIZE_MAX;
+}
+
+void simple_renderer_reload_shaders(Simple_Renderer *sr)
+{
+    // The software backend has its shaders compiled in
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE) return;
+
+    GLuint programs[COUNT_SIMPLE_SHADERS] = {0};
+    GLuint quad_program = 0;
+
+    if (!load_programs(vert_shader_file_path, programs)) return;
+    if (!load_quad_program(&quad_program))
+    {
+        for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
         {
-            exit(1);
+            glDeleteProgram(programs[i]);
         }
-        glDeleteShader(shaders[1]);
+        return;
     }
-    glDeleteShader(shaders[0]);
+
+    simple_renderer_assign_programs(sr, programs, quad_program);
+    printf("Reloaded shaders successfully!\n");
 }
 
-void simple_renderer_reload_shaders(Simple_Renderer *sr)
+static void simple_renderer_bind_vao(Simple_Renderer *sr, GLuint vao)
 {
-    GLuint programs[COUNT_SIMPLE_SHADERS];
-    GLuint shaders[2] = {0};
+    if (sr->bound_vao == vao) return;
+    glBindVertexArray(vao);
+    sr->bound_vao = vao;
+    sr->stats.gl_calls += 1;
+}
 
-    bool ok = true;
+static void simple_renderer_bind_array_buffer(Simple_Renderer *sr, GLuint buffer)
+{
+    if (sr->bound_array_buffer == buffer) return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    sr->bound_array_buffer = buffer;
+    sr->stats.gl_calls += 1;
+}
 
-    if (!compile_shader_file(vert_shader_file_path, GL_VERTEX_SHADER, &shaders[0]))
+static void simple_renderer_use_program(Simple_Renderer *sr, Simple_Program *program)
+{
+    if (sr->bound_program != program->id)
     {
-        ok = false;
+        glUseProgram(program->id);
+        sr->bound_program = program->id;
+        sr->stats.gl_calls += 1;
     }
 
-    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+    if (!program->synced || program->resolution.x != sr->resolution.x || program->resolution.y != sr->resolution.y)
     {
-        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1]))
-        {
-            ok = false;
-        }
-        programs[i] = glCreateProgram();
-        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), programs[i]);
-        if (!link_program(programs[i], __FILE__, __LINE__))
-        {
-            ok = false;
-        }
-        glDeleteShader(shaders[1]);
+        glUniform2f(program->uniforms[UNIFORM_SLOT_RESOLUTION], sr->resolution.x, sr->resolution.y);
+        program->resolution = sr->resolution;
+        sr->stats.gl_calls += 1;
     }
-    glDeleteShader(shaders[0]);
+    if (!program->synced || program->time != sr->time)
+    {
+        glUniform1f(program->uniforms[UNIFORM_SLOT_TIME], sr->time);
+        program->time = sr->time;
+        sr->stats.gl_calls += 1;
+    }
+    if (!program->synced || program->camera_pos.x != sr->camera_pos.x || program->camera_pos.y != sr->camera_pos.y)
+    {
+        glUniform2f(program->uniforms[UNIFORM_SLOT_CAMERA_POS], sr->camera_pos.x, sr->camera_pos.y);
+        program->camera_pos = sr->camera_pos;
+        sr->stats.gl_calls += 1;
+    }
+    if (!program->synced || program->camera_scale != sr->camera_scale)
+    {
+        glUniform1f(program->uniforms[UNIFORM_SLOT_CAMERA_SCALE], sr->camera_scale);
+        program->camera_scale = sr->camera_scale;
+        sr->stats.gl_calls += 1;
+    }
+    program->synced = true;
+}
 
-    if (ok)
+void simple_renderer_resize(Simple_Renderer *sr, int width, int height)
+{
+    sr->framebuffer = vec2f((float)width, (float)height);
+    sr->resolution = sr->framebuffer;
+    sr->viewport_pos = vec2fs(0.0f);
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
     {
-        for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
-        {
-            glDeleteProgram(sr->programs[i]);
-            sr->programs[i] = programs[i];
-        }
-        printf("Reloaded shaders successfully!\n");
+        simple_software_resize(sr->software, width, height);
     }
     else
     {
-        for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i)
+        glViewport(0, 0, width, height);
+    }
+}
+
+void simple_renderer_set_viewport(Simple_Renderer *sr, Vec2f pos, Vec2f size)
+{
+    simple_renderer_flush(sr);
+    sr->viewport_pos = pos;
+    sr->resolution = size;
+    // The software backend takes the viewport from sr on every draw
+    if (sr->backend == SIMPLE_BACKEND_GL)
+    {
+        // GL counts the rows from the bottom
+        glViewport((GLint)pos.x, (GLint)(sr->framebuffer.y - pos.y - size.y), (GLsizei)size.x, (GLsizei)size.y);
+        sr->stats.gl_calls += 1;
+    }
+}
+
+void simple_renderer_reset_viewport(Simple_Renderer *sr)
+{
+    simple_renderer_set_viewport(sr, vec2fs(0.0f), sr->framebuffer);
+}
+
+void simple_renderer_clear(Simple_Renderer *sr, Vec4f color)
+{
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
+    {
+        simple_software_clear(sr->software, color);
+    }
+    else
+    {
+        glClearColor(color.x, color.y, color.z, color.w);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+}
+
+void simple_renderer_read_pixels(Simple_Renderer *sr, uint8_t *pixels)
+{
+    size_t width = (size_t)sr->framebuffer.x;
+    size_t height = (size_t)sr->framebuffer.y;
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
+    {
+        memcpy(pixels, simple_software_pixels(sr->software), width * height * 4);
+        return;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    // GL reads the bottom row first
+    for (size_t y = 0; y < height / 2; ++y)
+    {
+        uint8_t *top = pixels + y * width * 4;
+        uint8_t *bottom = pixels + (height - 1 - y) * width * 4;
+        for (size_t i = 0; i < width * 4; ++i)
         {
-            glDeleteProgram(programs[i]);
+            SWAP(uint8_t, top[i], bottom[i]);
         }
     }
 }
 
+void simple_renderer_set_glyph_atlas(Simple_Renderer *sr, const uint8_t *pixels, size_t width, size_t height)
+{
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
+    {
+        simple_software_set_atlas(sr->software, pixels, width, height);
+        return;
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    if (sr->glyph_atlas_texture == 0) glGenTextures(1, &sr->glyph_atlas_texture);
+    glBindTexture(GL_TEXTURE_2D, sr->glyph_atlas_texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        GL_RED,
+        (GLsizei)width,
+        (GLsizei)height,
+        0,
+        GL_RED,
+        GL_UNSIGNED_BYTE,
+        pixels);
+}
+
+void simple_renderer_set_glyph_metrics(Simple_Renderer *sr, const Vec4f *rects, const Vec4f *uvs, size_t count)
+{
+    assert(count <= SIMPLE_GLYPH_METRICS_CAP);
+    memcpy(sr->glyph_rects, rects, count * sizeof(Vec4f));
+    memcpy(sr->glyph_uvs, uvs, count * sizeof(Vec4f));
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE) return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, sr->glyph_metrics_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(Vec4f), rects);
+    glBufferSubData(GL_UNIFORM_BUFFER, SIMPLE_GLYPH_METRICS_CAP * sizeof(Vec4f), count * sizeof(Vec4f), uvs);
+}
+
+static uint8_t pack_unorm8(float x)
+{
+    if (x <= 0.0f) return 0;
+    if (x >= 1.0f) return UINT8_MAX;
+    return (uint8_t)(x * UINT8_MAX + 0.5f);
+}
+
+static uint16_t pack_unorm16(float x)
+{
+    if (x <= 0.0f) return 0;
+    if (x >= 1.0f) return UINT16_MAX;
+    return (uint16_t)(x * UINT16_MAX + 0.5f);
+}
+
 // TODO: Don't render triples of verticies that form a triangle that is completely outside of the screen
 //
 // Ideas on how to check if a triangle is outside of the screen:
@@ -265,18 +561,16 @@ void simple_renderer_reload_shaders(Simple_Renderer *sr)
 // simple_renderer_vertex() for a potentially large amount of verticies in the first place.
 void simple_renderer_vertex(Simple_Renderer *sr, Vec2f p, Vec4f c, Vec2f uv)
 {
-#if 0
-    // TODO: flush the renderer on vertex buffer overflow instead firing the assert
+    // NOTE: SIMPLE_VERTICIES_CAP is divisible by 3, so the batch always fills up on a triangle boundary
     if (sr->verticies_count >= SIMPLE_VERTICIES_CAP) simple_renderer_flush(sr);
-#else
-    // NOTE: it is better to just crash the app in this case until the culling described
-    // above is sorted out.
-    assert(sr->verticies_count < SIMPLE_VERTICIES_CAP);
-#endif
     Simple_Vertex *last = &sr->verticies[sr->verticies_count];
     last->position = p;
-    last->color = c;
-    last->uv = uv;
+    last->color[0] = pack_unorm8(c.x);
+    last->color[1] = pack_unorm8(c.y);
+    last->color[2] = pack_unorm8(c.z);
+    last->color[3] = pack_unorm8(c.w);
+    last->uv[0] = pack_unorm16(uv.x);
+    last->uv[1] = pack_unorm16(uv.y);
     sr->verticies_count += 1;
 }
 
@@ -311,43 +605,222 @@ void simple_renderer_image_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec2f uvp
         uvp, vec2f_add(uvp, vec2f(uvs.x, 0)), vec2f_add(uvp, vec2f(0, uvs.y)), vec2f_add(uvp, uvs));
 }
 
+static void simple_renderer_push_quad(Simple_Renderer *sr, Vec2f position, Vec2f size, Vec4f c, uint16_t index)
+{
+    if (sr->quads_count >= SIMPLE_QUADS_CAP) simple_renderer_flush(sr);
+    Simple_Quad *last = &sr->quads[sr->quads_count];
+    last->position = position;
+    last->size = size;
+    last->color[0] = pack_unorm8(c.x);
+    last->color[1] = pack_unorm8(c.y);
+    last->color[2] = pack_unorm8(c.z);
+    last->color[3] = pack_unorm8(c.w);
+    last->index = index;
+    last->shader = (uint8_t)sr->current_shader;
+    last->padding = 0;
+    sr->quads_count += 1;
+}
+
 void simple_renderer_solid_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec4f c)
 {
-    Vec2f uv = vec2fs(0);
-    simple_renderer_quad(
-        sr,
-        p, vec2f_add(p, vec2f(s.x, 0)), vec2f_add(p, vec2f(0, s.y)), vec2f_add(p, s),
-        c, c, c, c,
-        uv, uv, uv, uv);
+    simple_renderer_push_quad(sr, p, s, c, SIMPLE_QUAD_NO_GLYPH);
+}
+
+void simple_renderer_glyph(Simple_Renderer *sr, Vec2f pen, size_t index, Vec4f c)
+{
+    assert(index < SIMPLE_QUAD_NO_GLYPH);
+    simple_renderer_push_quad(sr, pen, vec2fs(0), c, (uint16_t)index);
+}
+
+void simple_renderer_begin_overlay(Simple_Renderer *sr, float scale)
+{
+    assert(!sr->overlay && "Overlays do not nest");
+    simple_renderer_flush(sr);
+    sr->overlay = true;
+    sr->overlay_camera_pos = sr->camera_pos;
+    sr->overlay_camera_scale = sr->camera_scale;
+    sr->overlay_shader = sr->current_shader;
+    sr->camera_scale = scale;
+    sr->camera_pos = vec2f_div(sr->resolution, vec2fs(2.0f * scale));
+}
+
+void simple_renderer_end_overlay(Simple_Renderer *sr)
+{
+    assert(sr->overlay && "simple_renderer_end_overlay() without simple_renderer_begin_overlay()");
+    simple_renderer_flush(sr);
+    sr->overlay = false;
+    sr->camera_pos = sr->overlay_camera_pos;
+    sr->camera_scale = sr->overlay_camera_scale;
+    simple_renderer_set_shader(sr, sr->overlay_shader);
+}
+
+Vec2f simple_renderer_overlay_point(const Simple_Renderer *sr, float x, float y)
+{
+    assert(sr->overlay);
+    return vec2f(x / sr->camera_scale, (sr->resolution.y - y) / sr->camera_scale);
+}
+
+void simple_renderer_overlay_rect(Simple_Renderer *sr, float x, float y, float w, float h, Vec4f c)
+{
+    simple_renderer_solid_rect(sr, simple_renderer_overlay_point(sr, x, y + h), vec2f(w / sr->camera_scale, h / sr->camera_scale), c);
+}
+
+// Appends `count` elements to a streaming ring buffer currently bound to GL_ARRAY_BUFFER
+// and returns the element offset they were written at.
+static size_t stream_to_ring(Simple_Renderer *sr, size_t *ring_offset, size_t ring_cap, const void *data, size_t count, size_t element_size)
+{
+    if (*ring_offset + count > ring_cap)
+    {
+        // Orphan the buffer. The driver hands out fresh storage while the GPU is still
+        // drawing from the old one, so we never have to wait for it.
+        glBufferData(GL_ARRAY_BUFFER, ring_cap * element_size, NULL, GL_STREAM_DRAW);
+        *ring_offset = 0;
+        sr->stats.gl_calls += 1;
+    }
+
+    // Nothing in flight ever touches the range past ring_offset, so it is safe to skip the synchronization
+    void *dst = glMapBufferRange(GL_ARRAY_BUFFER,
+                                 *ring_offset * element_size,
+                                 count * element_size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst != NULL)
+    {
+        memcpy(dst, data, count * element_size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        sr->stats.gl_calls += 2;
+    }
+    else
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, *ring_offset * element_size, count * element_size, data);
+        sr->stats.gl_calls += 2;
+    }
+
+    size_t offset = *ring_offset;
+    *ring_offset += count;
+    return offset;
 }
 
 void simple_renderer_sync(Simple_Renderer *sr)
 {
-    glBufferSubData(GL_ARRAY_BUFFER,
-                    0,
-                    sr->verticies_count * sizeof(Simple_Vertex),
-                    sr->verticies);
+    // The software backend reads the batches right where they are
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE) return;
+
+    if (sr->verticies_count > 0)
+    {
+        simple_renderer_bind_array_buffer(sr, sr->vbo);
+        sr->ring_drawn = stream_to_ring(sr, &sr->ring_offset, SIMPLE_VERTICIES_RING_CAP,
+                                        sr->verticies, sr->verticies_count, sizeof(Simple_Vertex));
+        sr->stats.bytes_uploaded += sr->verticies_count * sizeof(Simple_Vertex);
+    }
+
+    if (sr->quads_count > 0)
+    {
+        simple_renderer_bind_array_buffer(sr, sr->quad_vbo);
+        sr->quads_ring_drawn = stream_to_ring(sr, &sr->quads_ring_offset, SIMPLE_QUADS_RING_CAP,
+                                               sr->quads, sr->quads_count, sizeof(Simple_Quad));
+        sr->stats.bytes_uploaded += sr->quads_count * sizeof(Simple_Quad);
+    }
+}
+
+// There is no base instance in GL 3.3, so the attribute pointers of the quad VAO
+// have to follow the ring offset of the batch being drawn instead
+static void simple_renderer_point_quad_attribs(Simple_Renderer *sr)
+{
+    if (sr->quad_attribs_base == sr->quads_ring_drawn) return;
+
+    simple_renderer_bind_array_buffer(sr, sr->quad_vbo);
+    size_t base = sr->quads_ring_drawn * sizeof(Simple_Quad);
+    glVertexAttribPointer(
+        SIMPLE_QUAD_ATTR_POSITION,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Simple_Quad),
+        (GLvoid *)(base + offsetof(Simple_Quad, position)));
+    glVertexAttribPointer(
+        SIMPLE_QUAD_ATTR_SIZE,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Simple_Quad),
+        (GLvoid *)(base + offsetof(Simple_Quad, size)));
+    glVertexAttribPointer(
+        SIMPLE_QUAD_ATTR_COLOR,
+        4,
+        GL_UNSIGNED_BYTE,
+        GL_TRUE,
+        sizeof(Simple_Quad),
+        (GLvoid *)(base + offsetof(Simple_Quad, color)));
+    glVertexAttribIPointer(
+        SIMPLE_QUAD_ATTR_INDEX,
+        1,
+        GL_UNSIGNED_SHORT,
+        sizeof(Simple_Quad),
+        (GLvoid *)(base + offsetof(Simple_Quad, index)));
+    glVertexAttribIPointer(
+        SIMPLE_QUAD_ATTR_SHADER,
+        1,
+        GL_UNSIGNED_BYTE,
+        sizeof(Simple_Quad),
+        (GLvoid *)(base + offsetof(Simple_Quad, shader)));
+    sr->quad_attribs_base = sr->quads_ring_drawn;
+    sr->stats.gl_calls += 5;
 }
 
 void simple_renderer_draw(Simple_Renderer *sr)
 {
-    glDrawArrays(GL_TRIANGLES, 0, sr->verticies_count);
+    if (sr->backend == SIMPLE_BACKEND_SOFTWARE)
+    {
+        if (sr->verticies_count == 0 && sr->quads_count == 0) return;
+        simple_software_draw(sr->software, sr);
+        sr->stats.draw_calls += 1;
+        sr->stats.verticies += sr->verticies_count;
+        sr->stats.quads += sr->quads_count;
+        return;
+    }
+
+    // Triangles go first, so the text always ends up on top of the rectangles of the same batch
+    if (sr->verticies_count > 0)
+    {
+        simple_renderer_use_program(sr, &sr->programs[sr->current_shader]);
+        simple_renderer_bind_vao(sr, sr->vao);
+        glDrawArrays(GL_TRIANGLES, sr->ring_drawn, sr->verticies_count);
+        sr->stats.draw_calls += 1;
+        sr->stats.gl_calls += 1;
+        sr->stats.verticies += sr->verticies_count;
+    }
+
+    if (sr->quads_count > 0)
+    {
+        simple_renderer_use_program(sr, &sr->quad_program);
+        simple_renderer_bind_vao(sr, sr->quad_vao);
+        simple_renderer_point_quad_attribs(sr);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, sr->quads_count);
+        sr->stats.draw_calls += 1;
+        sr->stats.gl_calls += 1;
+        sr->stats.quads += sr->quads_count;
+    }
 }
 
 void simple_renderer_set_shader(Simple_Renderer *sr, Simple_Shader shader)
 {
+    // Quads carry their shader with them, so only the pending triangles need
+    // to go out before the switch. The program itself is bound in simple_renderer_draw().
+    if (sr->verticies_count > 0 && sr->current_shader != shader) simple_renderer_flush(sr);
     sr->current_shader = shader;
-    glUseProgram(sr->programs[sr->current_shader]);
-    get_uniform_location(sr->programs[sr->current_shader], sr->uniforms);
-    glUniform2f(sr->uniforms[UNIFORM_SLOT_RESOLUTION], sr->resolution.x, sr->resolution.y);
-    glUniform1f(sr->uniforms[UNIFORM_SLOT_TIME], sr->time);
-    glUniform2f(sr->uniforms[UNIFORM_SLOT_CAMERA_POS], sr->camera_pos.x, sr->camera_pos.y);
-    glUniform1f(sr->uniforms[UNIFORM_SLOT_CAMERA_SCALE], sr->camera_scale);
 }
 
 void simple_renderer_flush(Simple_Renderer *sr)
 {
+    TRACE_BEGIN("simple_renderer_flush");
+    profiler_begin(PROFILER_STAGE_SYNC);
     simple_renderer_sync(sr);
+    profiler_end(PROFILER_STAGE_SYNC);
+
+    profiler_begin(PROFILER_STAGE_DRAW);
     simple_renderer_draw(sr);
+    profiler_end(PROFILER_STAGE_DRAW);
     sr->verticies_count = 0;
+    sr->quads_count = 0;
+    TRACE_END("simple_renderer_flush");
 }
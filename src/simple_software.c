@@ -0,0 +1,702 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "simple_software.h"
+#include "common.h"
+
+#define SOFTWARE_BAND_HEIGHT 32
+#define SOFTWARE_MAX_WORKERS 15
+
+// Marks quads in the bins, everything else is a triangle
+#define SOFTWARE_QUAD_BIT 0x80000000u
+
+// Quad as it lands on the screen, top row first
+typedef struct
+{
+    float x0, y0, x1, y1;
+    float u0, v0; // uv at (x0, y0)
+    float du, dv; // change of the uv per pixel
+    float color[4];
+    Simple_Shader shader;
+} Software_Quad;
+
+typedef struct
+{
+    Vec2f p[3]; // screen position, top row first
+    float color[3][4];
+    Vec2f uv[3];
+} Software_Triangle;
+
+typedef struct
+{
+    Software_Quad *items;
+    size_t count;
+    size_t capacity;
+} Software_Quads;
+
+typedef struct
+{
+    Software_Triangle *items;
+    size_t count;
+    size_t capacity;
+} Software_Triangles;
+
+// Primitives touching a band in the order they were submitted
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Software_Bin;
+
+typedef struct
+{
+    Simple_Software *sw;
+    size_t index;
+    SDL_Thread *thread;
+} Software_Worker;
+
+struct Simple_Software
+{
+    uint8_t *pixels;
+    int width;
+    int height;
+
+    uint8_t *atlas;
+    int atlas_width;
+    int atlas_height;
+
+    Software_Quads quads;
+    Software_Triangles triangles;
+    Software_Bin *bins;
+    size_t bins_count;
+
+    // Uniforms of the draw in flight
+    Simple_Shader triangles_shader;
+    float time;
+    Vec2f resolution;
+    // The viewport in pixels, nothing is drawn outside of [x0, x1) x [y0, y1)
+    int clip_x0, clip_y0;
+    int clip_x1, clip_y1;
+
+    // Row buffers for the SDF derivatives, one per thread with the main thread at index 0
+    float *scratch[SOFTWARE_MAX_WORKERS + 1];
+
+    SDL_mutex *mutex;
+    SDL_cond *wake;
+    SDL_cond *done;
+    uint64_t generation;
+    size_t busy;
+    bool quit;
+    SDL_atomic_t next_band;
+    Software_Worker workers[SOFTWARE_MAX_WORKERS];
+    size_t workers_count;
+};
+
+static float clampf(float x, float lo, float hi)
+{
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+
+static int clampi(int x, int lo, int hi)
+{
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+
+static float smoothstepf(float edge0, float edge1, float x)
+{
+    if (edge1 <= edge0) return x < edge0 ? 0.0f : 1.0f;
+    float t = clampf((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// GLSL mod()
+static float modf_glsl(float x, float y)
+{
+    return x - y * floorf(x / y);
+}
+
+// Same as hsl2rgb() of shaders/simple_epic.frag
+static void hsl2rgb(float h, float s, float l, float rgb[3])
+{
+    static const float offsets[3] = {0.0f, 4.0f, 2.0f};
+    for (int i = 0; i < 3; ++i)
+    {
+        float c = clampf(fabsf(modf_glsl(h * 6.0f + offsets[i], 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+        rgb[i] = l + s * (c - 0.5f) * (1.0f - fabsf(2.0f * l - 1.0f));
+    }
+}
+
+// Bilinear with clamping to the edge, like the GL_LINEAR atlas texture
+static float software_sample(const Simple_Software *sw, float u, float v)
+{
+    if (sw->atlas == NULL) return 0.0f;
+
+    float x = u * (float)sw->atlas_width - 0.5f;
+    float y = v * (float)sw->atlas_height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float tx = x - fx;
+    float ty = y - fy;
+
+    int x0 = clampi((int)fx, 0, sw->atlas_width - 1);
+    int x1 = clampi((int)fx + 1, 0, sw->atlas_width - 1);
+    int y0 = clampi((int)fy, 0, sw->atlas_height - 1);
+    int y1 = clampi((int)fy + 1, 0, sw->atlas_height - 1);
+
+    const uint8_t *row0 = sw->atlas + (size_t)y0 * sw->atlas_width;
+    const uint8_t *row1 = sw->atlas + (size_t)y1 * sw->atlas_width;
+    float a = row0[x0] + (row0[x1] - row0[x0]) * tx;
+    float b = row1[x0] + (row1[x1] - row1[x0]) * tx;
+    return (a + (b - a) * ty) / 255.0f;
+}
+
+// The branches of shaders/simple_uber.frag. `d` is the atlas sample and `aaf` its fwidth().
+static void software_shade(const Simple_Software *sw, Simple_Shader shader, const float color[4], float d, float aaf, int x, int y, float out[4])
+{
+    switch (shader)
+    {
+    case SHADER_FOR_COLOR:
+        memcpy(out, color, 4 * sizeof(float));
+        break;
+    case SHADER_FOR_IMAGE:
+        out[0] = d;
+        out[1] = 0.0f;
+        out[2] = 0.0f;
+        out[3] = 1.0f;
+        break;
+    case SHADER_FOR_TEXT:
+        memcpy(out, color, 3 * sizeof(float));
+        out[3] = smoothstepf(0.5f - aaf, 0.5f + aaf, d);
+        break;
+    case SHADER_FOR_EPICNESS:
+    default:
+    {
+        // gl_FragCoord counts rows from the bottom
+        float frag_u = ((float)x + 0.5f) / sw->resolution.x;
+        float frag_v = ((float)(sw->height - y) - 0.5f) / sw->resolution.y;
+        hsl2rgb(sw->time + frag_u + frag_v, 0.5f, 0.5f, out);
+        out[3] = smoothstepf(0.5f - aaf, 0.5f + aaf, d);
+    }
+    break;
+    }
+}
+
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), applied to the alpha channel as well
+static void software_blend(uint8_t *dst, const float src[4])
+{
+    float a = clampf(src[3], 0.0f, 1.0f);
+    float b = 1.0f - a;
+    for (int i = 0; i < 3; ++i)
+    {
+        dst[i] = (uint8_t)(clampf(src[i], 0.0f, 1.0f) * 255.0f * a + (float)dst[i] * b + 0.5f);
+    }
+    dst[3] = (uint8_t)(a * a * 255.0f + (float)dst[3] * b + 0.5f);
+}
+
+// The v of a quad only changes from row to row, so the rows of the atlas and the vertical
+// weight are picked once per row. Clamping the coordinate to the atlas before splitting it up
+// gives the same result as clamping the texel indices.
+static void software_sample_row(const Simple_Software *sw, const Software_Quad *q, int x, int count, int y, float *out)
+{
+    if (sw->atlas == NULL)
+    {
+        memset(out, 0, (size_t)count * sizeof(float));
+        return;
+    }
+
+    const float max_x = (float)(sw->atlas_width - 1);
+    const float max_y = (float)(sw->atlas_height - 1);
+
+    float v = q->v0 + ((float)y + 0.5f - q->y0) * q->dv;
+    float ay = clampf(v * (float)sw->atlas_height - 0.5f, 0.0f, max_y);
+    int y0 = (int)ay;
+    int y1 = y0 + (y0 < sw->atlas_height - 1);
+    float ty = ay - (float)y0;
+    const uint8_t *row0 = sw->atlas + (size_t)y0 * sw->atlas_width;
+    const uint8_t *row1 = sw->atlas + (size_t)y1 * sw->atlas_width;
+
+    float ax = (q->u0 + ((float)x + 0.5f - q->x0) * q->du) * (float)sw->atlas_width - 0.5f;
+    float dax = q->du * (float)sw->atlas_width;
+    for (int i = 0; i < count; ++i)
+    {
+        float fx = clampf(ax + (float)i * dax, 0.0f, max_x);
+        int x0 = (int)fx;
+        int x1 = x0 + (x0 < sw->atlas_width - 1);
+        float tx = fx - (float)x0;
+        float a = row0[x0] + (row0[x1] - row0[x0]) * tx;
+        float b = row1[x0] + (row1[x1] - row1[x0]) * tx;
+        out[i] = (a + (b - a) * ty) / 255.0f;
+    }
+}
+
+// The color, premultiplied and scaled to bytes, and what the destination is scaled by.
+// Same blending as software_blend().
+typedef struct
+{
+    float rgb[3];
+    float alpha;
+} Software_Source;
+
+static Software_Source software_source(const float color[4])
+{
+    Software_Source src;
+    src.alpha = clampf(color[3], 0.0f, 1.0f);
+    for (int i = 0; i < 3; ++i) src.rgb[i] = clampf(color[i], 0.0f, 1.0f) * 255.0f;
+    return src;
+}
+
+static void software_blend_alpha(uint8_t *dst, const float rgb[3], float a)
+{
+    float b = 1.0f - a;
+    dst[0] = (uint8_t)(rgb[0] * a + (float)dst[0] * b + 0.5f);
+    dst[1] = (uint8_t)(rgb[1] * a + (float)dst[1] * b + 0.5f);
+    dst[2] = (uint8_t)(rgb[2] * a + (float)dst[2] * b + 0.5f);
+    dst[3] = (uint8_t)(a * a * 255.0f + (float)dst[3] * b + 0.5f);
+}
+
+static void software_span_color(uint8_t *dst, int count, const Software_Source *src)
+{
+    for (int i = 0; i < count; ++i, dst += 4)
+    {
+        software_blend_alpha(dst, src->rgb, src->alpha);
+    }
+}
+
+// The alpha of an SDF glyph, fwidth() is approximated with forward differences so every
+// pixel needs the one to its right and the one below it
+static float software_sdf_alpha(const float *row, const float *next, int i)
+{
+    float d = row[i];
+    float aaf = fabsf(row[i + 1] - d) + fabsf(next[i] - d);
+    return smoothstepf(0.5f - aaf, 0.5f + aaf, d);
+}
+
+static void software_span_text(uint8_t *dst, int count, const float *row, const float *next, const Software_Source *src)
+{
+    for (int i = 0; i < count; ++i, dst += 4)
+    {
+        // Most of the box of a glyph is empty
+        float a = software_sdf_alpha(row, next, i);
+        if (a <= 0.0f) continue;
+        software_blend_alpha(dst, src->rgb, a);
+    }
+}
+
+static void software_span_epicness(const Simple_Software *sw, uint8_t *dst, int x, int y, int count, const float *row, const float *next)
+{
+    // gl_FragCoord counts rows from the bottom
+    float frag_v = ((float)(sw->height - y) - 0.5f) / sw->resolution.y;
+    float rgb[3];
+    for (int i = 0; i < count; ++i, dst += 4)
+    {
+        float a = software_sdf_alpha(row, next, i);
+        if (a <= 0.0f) continue;
+        float frag_u = ((float)(x + i) + 0.5f) / sw->resolution.x;
+        hsl2rgb(sw->time + frag_u + frag_v, 0.5f, 0.5f, rgb);
+        for (int j = 0; j < 3; ++j) rgb[j] = clampf(rgb[j], 0.0f, 1.0f) * 255.0f;
+        software_blend_alpha(dst, rgb, a);
+    }
+}
+
+static void software_span_image(uint8_t *dst, int count, const float *row)
+{
+    for (int i = 0; i < count; ++i, dst += 4)
+    {
+        float rgb[3] = {clampf(row[i], 0.0f, 1.0f) * 255.0f, 0.0f, 0.0f};
+        software_blend_alpha(dst, rgb, 1.0f);
+    }
+}
+
+// The shader is the same for the whole quad, so it is picked once and every row goes through
+// the span loop of that shader instead of software_shade() switching on it for every pixel
+static void software_draw_quad(const Simple_Software *sw, const Software_Quad *q, int band_y0, int band_y1, float *scratch)
+{
+    // Pixel centers inside of [x0, x1) x [y0, y1)
+    int px0 = clampi((int)ceilf(q->x0 - 0.5f), sw->clip_x0, sw->clip_x1);
+    int px1 = clampi((int)ceilf(q->x1 - 0.5f), sw->clip_x0, sw->clip_x1);
+    int py0 = clampi((int)ceilf(q->y0 - 0.5f), band_y0, band_y1);
+    int py1 = clampi((int)ceilf(q->y1 - 0.5f), band_y0, band_y1);
+    if (px0 >= px1 || py0 >= py1) return;
+
+    int span = px1 - px0;
+    Software_Source src = software_source(q->color);
+    if (q->shader == SHADER_FOR_COLOR)
+    {
+        for (int y = py0; y < py1; ++y)
+        {
+            software_span_color(sw->pixels + ((size_t)y * sw->width + px0) * 4, span, &src);
+        }
+        return;
+    }
+
+    // Every row needs the next one sampled as well for the derivatives. The rows are kept
+    // around to only sample every pixel once.
+    float *row = scratch;
+    float *next = scratch + span + 1;
+    software_sample_row(sw, q, px0, span + 1, py0, row);
+    for (int y = py0; y < py1; ++y)
+    {
+        software_sample_row(sw, q, px0, span + 1, y + 1, next);
+        uint8_t *dst = sw->pixels + ((size_t)y * sw->width + px0) * 4;
+        switch (q->shader)
+        {
+        case SHADER_FOR_IMAGE:
+            software_span_image(dst, span, row);
+            break;
+        case SHADER_FOR_TEXT:
+            software_span_text(dst, span, row, next, &src);
+            break;
+        case SHADER_FOR_EPICNESS:
+        default:
+            software_span_epicness(sw, dst, px0, y, span, row, next);
+            break;
+        }
+        SWAP(float *, row, next);
+    }
+}
+
+static float software_edge(Vec2f a, Vec2f b, Vec2f c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static Vec2f software_triangle_uv(const Software_Triangle *t, float area, Vec2f p)
+{
+    float w0 = software_edge(t->p[1], t->p[2], p) / area;
+    float w1 = software_edge(t->p[2], t->p[0], p) / area;
+    float w2 = 1.0f - w0 - w1;
+    return vec2f(t->uv[0].x * w0 + t->uv[1].x * w1 + t->uv[2].x * w2,
+                 t->uv[0].y * w0 + t->uv[1].y * w1 + t->uv[2].y * w2);
+}
+
+// Triangles only come from simple_renderer_image_rect() and friends, so there are few of them
+// and the plain per pixel edge functions are good enough.
+static void software_draw_triangle(const Simple_Software *sw, const Software_Triangle *t, int band_y0, int band_y1)
+{
+    float area = software_edge(t->p[0], t->p[1], t->p[2]);
+    if (area == 0.0f) return;
+
+    float min_x = fminf(t->p[0].x, fminf(t->p[1].x, t->p[2].x));
+    float max_x = fmaxf(t->p[0].x, fmaxf(t->p[1].x, t->p[2].x));
+    float min_y = fminf(t->p[0].y, fminf(t->p[1].y, t->p[2].y));
+    float max_y = fmaxf(t->p[0].y, fmaxf(t->p[1].y, t->p[2].y));
+    int px0 = clampi((int)ceilf(min_x - 0.5f), sw->clip_x0, sw->clip_x1);
+    int px1 = clampi((int)ceilf(max_x - 0.5f), sw->clip_x0, sw->clip_x1);
+    int py0 = clampi((int)ceilf(min_y - 0.5f), band_y0, band_y1);
+    int py1 = clampi((int)ceilf(max_y - 0.5f), band_y0, band_y1);
+
+    float out[4];
+    for (int y = py0; y < py1; ++y)
+    {
+        for (int x = px0; x < px1; ++x)
+        {
+            Vec2f p = vec2f((float)x + 0.5f, (float)y + 0.5f);
+            float w0 = software_edge(t->p[1], t->p[2], p) / area;
+            float w1 = software_edge(t->p[2], t->p[0], p) / area;
+            float w2 = software_edge(t->p[0], t->p[1], p) / area;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+            float color[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                color[i] = t->color[0][i] * w0 + t->color[1][i] * w1 + t->color[2][i] * w2;
+            }
+
+            float d = 0.0f;
+            float aaf = 0.0f;
+            if (sw->triangles_shader != SHADER_FOR_COLOR)
+            {
+                Vec2f uv = software_triangle_uv(t, area, p);
+                Vec2f uv_dx = software_triangle_uv(t, area, vec2f(p.x + 1.0f, p.y));
+                Vec2f uv_dy = software_triangle_uv(t, area, vec2f(p.x, p.y + 1.0f));
+                d = software_sample(sw, uv.x, uv.y);
+                aaf = fabsf(software_sample(sw, uv_dx.x, uv_dx.y) - d)
+                    + fabsf(software_sample(sw, uv_dy.x, uv_dy.y) - d);
+            }
+
+            software_shade(sw, sw->triangles_shader, color, d, aaf, x, y, out);
+            software_blend(sw->pixels + ((size_t)y * sw->width + x) * 4, out);
+        }
+    }
+}
+
+static void software_run_bands(Simple_Software *sw, size_t thread_index)
+{
+    for (;;)
+    {
+        size_t band = (size_t)SDL_AtomicAdd(&sw->next_band, 1);
+        if (band >= sw->bins_count) break;
+
+        int band_y0 = (int)band * SOFTWARE_BAND_HEIGHT;
+        int band_y1 = band_y0 + SOFTWARE_BAND_HEIGHT;
+        if (band_y0 < sw->clip_y0) band_y0 = sw->clip_y0;
+        if (band_y1 > sw->clip_y1) band_y1 = sw->clip_y1;
+
+        const Software_Bin *bin = &sw->bins[band];
+        for (size_t i = 0; i < bin->count; ++i)
+        {
+            uint32_t item = bin->items[i];
+            if (item & SOFTWARE_QUAD_BIT)
+            {
+                software_draw_quad(sw, &sw->quads.items[item & ~SOFTWARE_QUAD_BIT], band_y0, band_y1, sw->scratch[thread_index]);
+            }
+            else
+            {
+                software_draw_triangle(sw, &sw->triangles.items[item], band_y0, band_y1);
+            }
+        }
+    }
+}
+
+static int software_worker(void *data)
+{
+    Software_Worker *worker = data;
+    Simple_Software *sw = worker->sw;
+    uint64_t seen = 0;
+
+    for (;;)
+    {
+        SDL_LockMutex(sw->mutex);
+        while (!sw->quit && sw->generation == seen) SDL_CondWait(sw->wake, sw->mutex);
+        if (sw->quit)
+        {
+            SDL_UnlockMutex(sw->mutex);
+            return 0;
+        }
+        seen = sw->generation;
+        SDL_UnlockMutex(sw->mutex);
+
+        software_run_bands(sw, worker->index);
+
+        SDL_LockMutex(sw->mutex);
+        sw->busy -= 1;
+        if (sw->busy == 0) SDL_CondSignal(sw->done);
+        SDL_UnlockMutex(sw->mutex);
+    }
+}
+
+Simple_Software *simple_software_create(void)
+{
+    Simple_Software *sw = calloc(1, sizeof(*sw));
+    assert(sw != NULL && "Buy more RAM lol");
+
+    sw->mutex = SDL_CreateMutex();
+    sw->wake = SDL_CreateCond();
+    sw->done = SDL_CreateCond();
+
+    int workers_count = SDL_GetCPUCount() - 1;
+    if (workers_count < 0) workers_count = 0;
+    if (workers_count > SOFTWARE_MAX_WORKERS) workers_count = SOFTWARE_MAX_WORKERS;
+    for (int i = 0; i < workers_count; ++i)
+    {
+        Software_Worker *worker = &sw->workers[sw->workers_count];
+        worker->sw = sw;
+        worker->index = sw->workers_count + 1;
+        worker->thread = SDL_CreateThread(software_worker, "software_renderer", worker);
+        if (worker->thread == NULL)
+        {
+            fprintf(stderr, "WARNING: could not start a software renderer thread: %s\n", SDL_GetError());
+            break;
+        }
+        sw->workers_count += 1;
+    }
+
+    return sw;
+}
+
+void simple_software_destroy(Simple_Software *sw)
+{
+    SDL_LockMutex(sw->mutex);
+    sw->quit = true;
+    SDL_CondBroadcast(sw->wake);
+    SDL_UnlockMutex(sw->mutex);
+    for (size_t i = 0; i < sw->workers_count; ++i)
+    {
+        SDL_WaitThread(sw->workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < sw->bins_count; ++i) free(sw->bins[i].items);
+    for (size_t i = 0; i <= SOFTWARE_MAX_WORKERS; ++i) free(sw->scratch[i]);
+    free(sw->bins);
+    free(sw->quads.items);
+    free(sw->triangles.items);
+    free(sw->atlas);
+    free(sw->pixels);
+    SDL_DestroyCond(sw->done);
+    SDL_DestroyCond(sw->wake);
+    SDL_DestroyMutex(sw->mutex);
+    free(sw);
+}
+
+void simple_software_set_atlas(Simple_Software *sw, const uint8_t *pixels, size_t width, size_t height)
+{
+    free(sw->atlas);
+    sw->atlas = malloc(width * height);
+    assert(sw->atlas != NULL && "Buy more RAM lol");
+    memcpy(sw->atlas, pixels, width * height);
+    sw->atlas_width = (int)width;
+    sw->atlas_height = (int)height;
+}
+
+void simple_software_resize(Simple_Software *sw, int width, int height)
+{
+    if (width == sw->width && height == sw->height) return;
+
+    sw->width = width;
+    sw->height = height;
+    sw->pixels = realloc(sw->pixels, (size_t)width * height * 4);
+    assert(sw->pixels != NULL && "Buy more RAM lol");
+
+    for (size_t i = 0; i < sw->bins_count; ++i) free(sw->bins[i].items);
+    sw->bins_count = ((size_t)height + SOFTWARE_BAND_HEIGHT - 1) / SOFTWARE_BAND_HEIGHT;
+    free(sw->bins);
+    sw->bins = calloc(sw->bins_count, sizeof(*sw->bins));
+    assert(sw->bins != NULL && "Buy more RAM lol");
+
+    // A quad span is clipped to the screen, plus one column and one row for the derivatives
+    for (size_t i = 0; i <= sw->workers_count; ++i)
+    {
+        sw->scratch[i] = realloc(sw->scratch[i], 2 * ((size_t)width + 1) * sizeof(float));
+        assert(sw->scratch[i] != NULL && "Buy more RAM lol");
+    }
+}
+
+void simple_software_clear(Simple_Software *sw, Vec4f color)
+{
+    uint8_t rgba[4] = {
+        (uint8_t)(clampf(color.x, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (uint8_t)(clampf(color.y, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (uint8_t)(clampf(color.z, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (uint8_t)(clampf(color.w, 0.0f, 1.0f) * 255.0f + 0.5f),
+    };
+    size_t count = (size_t)sw->width * sw->height;
+    for (size_t i = 0; i < count; ++i)
+    {
+        memcpy(sw->pixels + i * 4, rgba, 4);
+    }
+}
+
+// Same as camera_project() of the vertex shaders followed by the viewport transform
+static Vec2f software_project(const Simple_Renderer *sr, Vec2f p)
+{
+    return vec2f((p.x - sr->camera_pos.x) * sr->camera_scale + sr->viewport_pos.x + sr->resolution.x * 0.5f,
+                 sr->viewport_pos.y + sr->resolution.y * 0.5f - (p.y - sr->camera_pos.y) * sr->camera_scale);
+}
+
+static void software_bin(Simple_Software *sw, uint32_t item, float x0, float y0, float x1, float y1)
+{
+    int px0 = clampi((int)ceilf(x0 - 0.5f), sw->clip_x0, sw->clip_x1);
+    int px1 = clampi((int)ceilf(x1 - 0.5f), sw->clip_x0, sw->clip_x1);
+    int py0 = clampi((int)ceilf(y0 - 0.5f), sw->clip_y0, sw->clip_y1);
+    int py1 = clampi((int)ceilf(y1 - 0.5f), sw->clip_y0, sw->clip_y1);
+    if (px0 >= px1 || py0 >= py1) return;
+
+    for (int band = py0 / SOFTWARE_BAND_HEIGHT; band <= (py1 - 1) / SOFTWARE_BAND_HEIGHT; ++band)
+    {
+        da_append(&sw->bins[band], item);
+    }
+}
+
+static void unpack_color(const uint8_t packed[4], float color[4])
+{
+    for (int i = 0; i < 4; ++i) color[i] = (float)packed[i] / 255.0f;
+}
+
+void simple_software_draw(Simple_Software *sw, const Simple_Renderer *sr)
+{
+    if (sw->pixels == NULL) return;
+
+    sw->triangles_shader = sr->current_shader;
+    sw->time = sr->time;
+    sw->resolution = sr->resolution;
+    sw->clip_x0 = clampi((int)sr->viewport_pos.x, 0, sw->width);
+    sw->clip_y0 = clampi((int)sr->viewport_pos.y, 0, sw->height);
+    sw->clip_x1 = clampi((int)(sr->viewport_pos.x + sr->resolution.x), sw->clip_x0, sw->width);
+    sw->clip_y1 = clampi((int)(sr->viewport_pos.y + sr->resolution.y), sw->clip_y0, sw->height);
+    sw->quads.count = 0;
+    sw->triangles.count = 0;
+    for (size_t i = 0; i < sw->bins_count; ++i) sw->bins[i].count = 0;
+
+    // Triangles go first, so the text always ends up on top of the rectangles of the same batch
+    for (size_t i = 0; i + 2 < sr->verticies_count; i += 3)
+    {
+        Software_Triangle t;
+        for (int j = 0; j < 3; ++j)
+        {
+            const Simple_Vertex *v = &sr->verticies[i + j];
+            t.p[j] = software_project(sr, v->position);
+            unpack_color(v->color, t.color[j]);
+            t.uv[j] = vec2f((float)v->uv[0] / UINT16_MAX, (float)v->uv[1] / UINT16_MAX);
+        }
+        software_bin(sw, (uint32_t)sw->triangles.count,
+                     fminf(t.p[0].x, fminf(t.p[1].x, t.p[2].x)), fminf(t.p[0].y, fminf(t.p[1].y, t.p[2].y)),
+                     fmaxf(t.p[0].x, fmaxf(t.p[1].x, t.p[2].x)), fmaxf(t.p[0].y, fmaxf(t.p[1].y, t.p[2].y)));
+        da_append(&sw->triangles, t);
+    }
+
+    for (size_t i = 0; i < sr->quads_count; ++i)
+    {
+        const Simple_Quad *quad = &sr->quads[i];
+        Software_Quad q = {0};
+        if (quad->index == SIMPLE_QUAD_NO_GLYPH)
+        {
+            Vec2f a = software_project(sr, quad->position);
+            Vec2f b = software_project(sr, vec2f_add(quad->position, quad->size));
+            q.x0 = fminf(a.x, b.x);
+            q.x1 = fmaxf(a.x, b.x);
+            q.y0 = fminf(a.y, b.y);
+            q.y1 = fmaxf(a.y, b.y);
+        }
+        else
+        {
+            Vec4f rect = sr->glyph_rects[quad->index];
+            Vec4f uv = sr->glyph_uvs[quad->index];
+            Vec2f top_left = software_project(sr, vec2f(quad->position.x + rect.x, quad->position.y + rect.y));
+            q.x0 = top_left.x;
+            q.y0 = top_left.y;
+            q.x1 = top_left.x + rect.z * sr->camera_scale;
+            q.y1 = top_left.y + rect.w * sr->camera_scale;
+            q.u0 = uv.x;
+            q.v0 = uv.y;
+            if (q.x1 > q.x0) q.du = uv.z / (q.x1 - q.x0);
+            if (q.y1 > q.y0) q.dv = uv.w / (q.y1 - q.y0);
+        }
+        unpack_color(quad->color, q.color);
+        q.shader = (Simple_Shader)quad->shader;
+
+        software_bin(sw, (uint32_t)sw->quads.count | SOFTWARE_QUAD_BIT, q.x0, q.y0, q.x1, q.y1);
+        da_append(&sw->quads, q);
+    }
+
+    SDL_AtomicSet(&sw->next_band, 0);
+    if (sw->workers_count > 0)
+    {
+        SDL_LockMutex(sw->mutex);
+        sw->generation += 1;
+        sw->busy = sw->workers_count;
+        SDL_CondBroadcast(sw->wake);
+        SDL_UnlockMutex(sw->mutex);
+    }
+
+    software_run_bands(sw, 0);
+
+    if (sw->workers_count > 0)
+    {
+        SDL_LockMutex(sw->mutex);
+        while (sw->busy > 0) SDL_CondWait(sw->done, sw->mutex);
+        SDL_UnlockMutex(sw->mutex);
+    }
+}
+
+const uint8_t *simple_software_pixels(const Simple_Software *sw)
+{
+    return sw->pixels;
+}
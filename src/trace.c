@@ -0,0 +1,145 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "trace.h"
+#include "common.h"
+
+// Power of two, so the ring index keeps working when the unsigned count wraps around
+#define TRACE_BUFFER_CAP (64 * 1024)
+
+typedef struct
+{
+    const char *name;
+    Uint64 ticks;
+    char phase; // 'B' or 'E'
+} Trace_Event;
+
+// Ring of the last TRACE_BUFFER_CAP events of a thread, so a dump always holds the hitch that
+// just happened rather than the startup. Only ever written by the thread that owns it. The count
+// of the events ever recorded is published after the event is written, so trace_dump() never
+// reads a half written one, and it rereads the count after copying to throw away the events the
+// owner overwrote in the meantime.
+typedef struct Trace_Buffer
+{
+    struct Trace_Buffer *next;
+    SDL_threadID thread_id;
+    SDL_atomic_t count;
+    SDL_atomic_t full;
+    Trace_Event events[TRACE_BUFFER_CAP];
+} Trace_Buffer;
+
+// Lock-free list of the buffers of every thread that ever recorded anything.
+// Buffers are never freed, the threads that own them may be gone by the time of the dump.
+static Trace_Buffer *trace_buffers = NULL;
+static _Thread_local Trace_Buffer *trace_buffer = NULL;
+
+static Trace_Buffer *trace_thread_buffer(void)
+{
+    if (trace_buffer != NULL) return trace_buffer;
+
+    Trace_Buffer *buffer = calloc(1, sizeof(*buffer));
+    assert(buffer != NULL && "Buy more RAM lol");
+    buffer->thread_id = SDL_ThreadID();
+    do {
+        buffer->next = SDL_AtomicGetPtr((void **)&trace_buffers);
+    } while (!SDL_AtomicCASPtr((void **)&trace_buffers, buffer->next, buffer));
+
+    trace_buffer = buffer;
+    return buffer;
+}
+
+static void trace_record(const char *name, char phase)
+{
+    Uint64 ticks = SDL_GetPerformanceCounter();
+    Trace_Buffer *buffer = trace_thread_buffer();
+    unsigned int count = (unsigned int)SDL_AtomicGet(&buffer->count);
+
+    buffer->events[count % TRACE_BUFFER_CAP] = (Trace_Event) {
+        .name = name,
+        .ticks = ticks,
+        .phase = phase,
+    };
+    if (count + 1 == TRACE_BUFFER_CAP) SDL_AtomicSet(&buffer->full, 1);
+    SDL_AtomicSet(&buffer->count, (int)(count + 1));
+}
+
+void trace_begin(const char *name)
+{
+    trace_record(name, 'B');
+}
+
+void trace_end(const char *name)
+{
+    trace_record(name, 'E');
+}
+
+void trace_dump(const char *file_path)
+{
+    const double us_per_tick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+    Trace_Event *events = malloc(TRACE_BUFFER_CAP * sizeof(*events));
+    assert(events != NULL && "Buy more RAM lol");
+
+    String_Builder json = {0};
+    sb_append_cstr(&json, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    size_t overwritten = 0;
+    char line[256];
+    for (Trace_Buffer *buffer = SDL_AtomicGetPtr((void **)&trace_buffers); buffer != NULL; buffer = buffer->next) {
+        bool full = SDL_AtomicGet(&buffer->full) != 0;
+        unsigned int begin_count = (unsigned int)SDL_AtomicGet(&buffer->count);
+        unsigned int n = full ? TRACE_BUFFER_CAP : begin_count;
+        unsigned int oldest = begin_count - n;
+        for (unsigned int i = 0; i < n; ++i) {
+            events[i] = buffer->events[(oldest + i) % TRACE_BUFFER_CAP];
+        }
+
+        // The owner may have lapped the oldest events while they were copied, counting the
+        // one it is writing right now
+        unsigned int end_count = (unsigned int)SDL_AtomicGet(&buffer->count);
+        unsigned int skip = 0;
+        if (end_count + 1 - oldest > TRACE_BUFFER_CAP) {
+            skip = end_count + 1 - oldest - TRACE_BUFFER_CAP;
+            if (skip > n) skip = n;
+        }
+        if (full) overwritten += begin_count - n + skip;
+
+        // The ring may start in the middle of a scope, drop the ends whose begins are gone
+        size_t depth = 0;
+        for (unsigned int i = skip; i < n; ++i) {
+            const Trace_Event *event = &events[i];
+            if (event->phase == 'B') {
+                depth += 1;
+            } else if (depth == 0) {
+                continue;
+            } else {
+                depth -= 1;
+            }
+            snprintf(line, sizeof(line),
+                     "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%lu}",
+                     first ? "" : ",\n", event->name, event->phase,
+                     (double)event->ticks * us_per_tick, (unsigned long)buffer->thread_id);
+            sb_append_cstr(&json, line);
+            first = false;
+        }
+    }
+    sb_append_cstr(&json, "\n]}\n");
+
+    Errno err = write_entire_file(file_path, json.items, json.count);
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not save trace to %s: %s\n", file_path, strerror(err));
+    } else {
+        printf("Saved trace to %s\n", file_path);
+        if (overwritten > 0) {
+            printf("Only the last %d events of every thread were kept, %zu older ones were overwritten\n",
+                   TRACE_BUFFER_CAP, overwritten);
+        }
+    }
+
+    free(json.items);
+    free(events);
+}